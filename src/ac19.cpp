@@ -96,19 +96,19 @@ bool ac19::attachDevice(libusb_device_handle *handle, int interfaceId, int produ
                 {"XP-Pen AC19 Shortcut Remote"},
         };
 
-        int pad_fd = create_pad(padArgs);
+        int pad_fd = create_pad(handle, padArgs);
         if (pad_fd < 0)
             return false;
-        uinputPads[handle] = pad_fd;
+        getDeviceContext(handle)->pad.fd = pad_fd;
     }
 
     return true;
 }
 
-bool ac19::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
+bool ac19::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
     switch (data[0]) {
         case 0x02:
-            handleFrameEvent(handle, data, dataLen);
+            handleFrameEvent(context, data, dataLen);
             break;
 
         default:
@@ -118,7 +118,7 @@ bool ac19::handleTransferData(libusb_device_handle *handle, unsigned char *data,
     return true;
 }
 
-void ac19::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void ac19::handleFrameEvent(device_context* context, unsigned char *data, size_t dataLen) {
     long button = 0;
 
     // We're going to use a lookup here because the buttons aren't logical
@@ -189,18 +189,18 @@ void ac19::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, s
     bool dialEvent = false;
 
     if (dialValue != 0) {
-        handleDialEvent(handle, REL_WHEEL, dialValue);
+        handleDialEvent(context, REL_WHEEL, dialValue);
         shouldSyn = false;
         dialEvent = true;
     }
 
     if (button != 0) {
-        handlePadButtonPressed(handle, button);
+        handlePadButtonPressed(context, button);
     } else if (!dialEvent) {
-        handlePadButtonUnpressed(handle);
+        handlePadButtonUnpressed(context);
     }
 
     if (shouldSyn) {
-        uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+        uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
     }
 }
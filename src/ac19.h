@@ -30,9 +30,9 @@ public:
     int sendInitKeyOnInterface();
     bool attachToInterfaceId(int interfaceId);
     bool attachDevice(libusb_device_handle* handle, int interfaceId, int productId);
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId);
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId);
 private:
-    void handleFrameEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
+    void handleFrameEvent(device_context* context, unsigned char* data, size_t dataLen);
 };
 
 
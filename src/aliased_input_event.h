@@ -19,6 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef USERSPACE_TABLET_DRIVER_DAEMON_ALIASED_INPUT_EVENT_H
 #define USERSPACE_TABLET_DRIVER_DAEMON_ALIASED_INPUT_EVENT_H
 
+#include <cstddef>
+
 struct aliased_input_event {
 public:
     int event_type;
@@ -26,4 +28,16 @@ public:
     int event_data;
 };
 
+// Non-owning view over a run of aliased events. Returned by the mapping lookups so that the hot path never copies.
+struct aliased_input_event_view {
+public:
+    const aliased_input_event* first;
+    size_t count;
+
+    const aliased_input_event* begin() const { return first; }
+    const aliased_input_event* end() const { return first + count; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+};
+
 #endif //USERSPACE_TABLET_DRIVER_DAEMON_ALIASED_INPUT_EVENT_H
@@ -0,0 +1,62 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include "aliased_input_event_table.h"
+
+aliased_input_event_table::aliased_input_event_table(int keyCount) : compiledIndex(keyCount, event_range{0, 0, false}) {
+
+}
+
+void aliased_input_event_table::set(int key, const std::vector<aliased_input_event> &events) {
+    if (key < 0 || key >= (int)compiledIndex.size()) {
+        std::cout << "Ignoring mapping for out of range key " << key << std::endl;
+        return;
+    }
+
+    mappings[key] = events;
+    compile();
+}
+
+bool aliased_input_event_table::find(int key, aliased_input_event_view &view) const {
+    if (key < 0 || key >= (int)compiledIndex.size() || !compiledIndex[key].mapped) {
+        return false;
+    }
+
+    const event_range& range = compiledIndex[key];
+    view.first = compiledEvents.data() + range.offset;
+    view.count = range.count;
+
+    return true;
+}
+
+void aliased_input_event_table::compile() {
+    compiledEvents.clear();
+    for (auto& range : compiledIndex) {
+        range = event_range{0, 0, false};
+    }
+
+    for (auto& mapping : mappings) {
+        compiledIndex[mapping.first] = event_range{
+            (unsigned int)compiledEvents.size(),
+            (unsigned int)mapping.second.size(),
+            true
+        };
+        compiledEvents.insert(compiledEvents.end(), mapping.second.begin(), mapping.second.end());
+    }
+}
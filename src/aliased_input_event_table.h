@@ -0,0 +1,49 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_ALIASED_INPUT_EVENT_TABLE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_ALIASED_INPUT_EVENT_TABLE_H
+
+#include <vector>
+#include <map>
+#include "aliased_input_event.h"
+
+// Flat lookup table from a small integer key to a run of aliased events. All events live in one contiguous
+// array that is rebuilt whenever a mapping changes so lookups are a single index and never allocate.
+class aliased_input_event_table {
+public:
+    aliased_input_event_table(int keyCount);
+
+    void set(int key, const std::vector<aliased_input_event>& events);
+    bool find(int key, aliased_input_event_view& view) const;
+private:
+    struct event_range {
+        unsigned int offset;
+        unsigned int count;
+        bool mapped;
+    };
+
+    void compile();
+
+    std::map<int, std::vector<aliased_input_event> > mappings;
+    std::vector<aliased_input_event> compiledEvents;
+    std::vector<event_range> compiledIndex;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_ALIASED_INPUT_EVENT_TABLE_H
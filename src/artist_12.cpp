@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "artist_12.h"
 
+static constexpr report_layout artist12Layout = xpPenReportLayout.withButtons(2, 1);
+
 artist_12::artist_12() {
     // Create a device specification for Artist 12 devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = false;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = artist12Layout;
     
     // Register product IDs and names
     spec.addProduct(0x094a, "XP-Pen Artist 12 (2nd Gen)");
@@ -53,29 +54,6 @@ void artist_12::setOffsetPressure(int productId) {
     }
 }
 
-bool artist_12::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            
-            // Use the generic frame event handler with button byte index but no dial
-            if (data[1] >= 0xf0) {
-                long button = data[deviceSpec.buttonByteIndex];
-                long position = ffsl(button);
-
-                if (button != 0) {
-                    handlePadButtonPressed(handle, position);
-                } else {
-                    handlePadButtonUnpressed(handle);
-                }
-
-                uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-            }
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+bool artist_12::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<artist12Layout>(context, data, dataLen);
 }
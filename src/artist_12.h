@@ -28,7 +28,7 @@ public:
 
     // Override only the methods that need custom behavior
     void setOffsetPressure(int productId) override;
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId) override;
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId) override;
 };
 
 
@@ -22,14 +22,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include "artist_12_pro.h"
 
+static constexpr report_layout artist12ProLayout = xpPenReportLayout.withButtons(2, 1).withWheel(7, 0x01, 0x02);
+
 artist_12_pro::artist_12_pro() {
     // Create a device specification for Artist 12 Pro devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = artist12ProLayout;
     
     // Register product IDs and names
     spec.addProduct(0x080a, "XP-Pen Artist 12 Pro");
@@ -51,16 +52,6 @@ artist_12_pro::artist_12_pro() {
     applyDefaultConfig(true);
 }
 
-bool artist_12_pro::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleGenericFrameEvent(handle, data, dataLen, deviceSpec.buttonByteIndex, deviceSpec.dialByteIndex);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+bool artist_12_pro::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<artist12ProLayout>(context, data, dataLen);
 }
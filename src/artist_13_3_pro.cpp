@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "artist_13_3_pro.h"
 
+static constexpr report_layout artist133ProLayout = xpPenReportLayout.withButtons(2, 1).withWheel(7, 0x01, 0x02);
+
 artist_13_3_pro::artist_13_3_pro() {
     // Create a device specification for artist_13_3_pro devices
     device_specification spec;
     spec.numButtons = 9;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = artist133ProLayout;
     
     // Register product IDs and names
     spec.addProduct(0x092b, "XP-Pen Artist 13.3 Pro");
@@ -47,53 +48,6 @@ artist_13_3_pro::artist_13_3_pro() {
     applyDefaultConfig(true);
 }
 
-bool artist_13_3_pro::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
-}
-
-void artist_13_3_pro::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        long button = data[2];
-        // Only 8 buttons on this device
-        long position = ffsl(data[2]);
-
-        std::bitset<8> dialBits(data[7]);
-
-        // Take the dial
-        short dialValue = 0;
-        if (dialBits.test(0)) {
-            dialValue = 1;
-        } else if (dialBits.test(1)) {
-            dialValue = -1;
-        }
-
-        bool shouldSyn = true;
-        bool dialEvent = false;
-
-        if (dialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, dialValue);
-            shouldSyn = false;
-            dialEvent = true;
-        }
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else if (!dialEvent) {
-            handlePadButtonUnpressed(handle);
-        }
-
-        if (shouldSyn) {
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-        }
-    }
+bool artist_13_3_pro::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<artist133ProLayout>(context, data, dataLen);
 }
@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "artist_22e_pro.h"
 
+static constexpr report_layout artist22eProLayout = xpPenReportLayout.withButtons(2, 3);
+
 artist_22e_pro::artist_22e_pro() {
     // Create a device specification for artist_22e_pro devices
     device_specification spec;
     spec.numButtons = 10;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = artist22eProLayout;
     
     // Register product IDs and names
     spec.addProduct(0x090b, "XP-Pen Artist 22E Pro");
@@ -47,33 +48,6 @@ artist_22e_pro::artist_22e_pro() {
     applyDefaultConfig(true);
 }
 
-bool artist_22e_pro::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
-}
-
-void artist_22e_pro::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        // Extract the button being pressed (If there is one)
-        long button = (data[4] << 16) + (data[3] << 8) + data[2];
-        // Grab the first bit set in the button long which tells us the button number
-        long position = ffsl(button);
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else {
-            handlePadButtonUnpressed(handle);
-        }
-
-        uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-    }
+bool artist_22e_pro::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<artist22eProLayout>(context, data, dataLen);
 }
@@ -27,10 +27,7 @@ public:
     artist_22e_pro();
 
     // Override only the methods that need custom behavior
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId) override;
-private:
-    // Helper method for handling frame events
-    void handleFrameEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId) override;
 };
 
 
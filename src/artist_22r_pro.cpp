@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "artist_22r_pro.h"
 
+static constexpr report_layout artist22rProLayout = xpPenReportLayout.withButtons(2, 3).withWheel(7, 0x01, 0x02);
+
 artist_22r_pro::artist_22r_pro() {
     // Create a device specification for artist_22r_pro devices
     device_specification spec;
     spec.numButtons = 10;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = artist22rProLayout;
     
     // Register product IDs and names
     spec.addProduct(0x0906, "XP-Pen Artist 22R Pro");
@@ -47,54 +48,6 @@ artist_22r_pro::artist_22r_pro() {
     applyDefaultConfig(true);
 }
 
-bool artist_22r_pro::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
-}
-
-void artist_22r_pro::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        // Extract the button being pressed (If there is one)
-        long button = (data[4] << 16) + (data[3] << 8) + data[2];
-        // Grab the first bit set in the button long which tells us the button number
-        long position = ffsl(button);
-
-        std::bitset<8> dialBits(data[7]);
-
-        // Take the left dial
-        short leftDialValue = 0;
-        if (dialBits.test(0)) {
-            leftDialValue = 1;
-        } else if (dialBits.test(1)) {
-            leftDialValue = -1;
-        }
-
-        bool shouldSyn = true;
-        bool dialEvent = false;
-
-        if (leftDialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, leftDialValue);
-            shouldSyn = false;
-            dialEvent = true;
-        }
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else if (!dialEvent) {
-            handlePadButtonUnpressed(handle);
-        }
-
-        if (shouldSyn) {
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-        }
-    }
+bool artist_22r_pro::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<artist22rProLayout>(context, data, dataLen);
 }
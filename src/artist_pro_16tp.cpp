@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "artist_pro_16tp.h"
 
+static constexpr report_layout artistPro16TpLayout = xpPenReportLayout;
+
 artist_pro_16tp::artist_pro_16tp() {
     // Create a device specification for artist_pro_16tp devices
     device_specification spec;
     spec.numButtons = 0;
     spec.hasDial = false;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = artistPro16TpLayout;
     
     // Register product IDs and names
     spec.addProduct(0x092e, "XP-Pen Artist Pro 16TP");
@@ -47,17 +48,8 @@ artist_pro_16tp::artist_pro_16tp() {
     applyDefaultConfig(false);
 }
 
-bool artist_pro_16tp::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+bool artist_pro_16tp::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<artistPro16TpLayout>(context, data, dataLen);
 }
 
 bool artist_pro_16tp::attachDevice(libusb_device_handle *handle, int interfaceId, int productId) {
@@ -74,7 +66,7 @@ bool artist_pro_16tp::attachDevice(libusb_device_handle *handle, int interfaceId
     // Hard coding these values in because the probe returns erroneous values.
     int maxWidth = 0x10e24;
     int maxHeight = 0x97dd;
-    maxPressure = (buf[9] << 8) + buf[8];
+    setMaxPressure((buf[9] << 8) + buf[8]);
     int resolution = (buf[11] << 8) + buf[10];
 
     std::string deviceName = "Artist Pro 16TP";
@@ -98,11 +90,11 @@ bool artist_pro_16tp::attachDevice(libusb_device_handle *handle, int interfaceId
                 {"XP-Pen Artist Pro 16TP"},
         };
 
-        auto pen_fd = create_pen(penArgs);
+        auto pen_fd = create_pen(handle, penArgs);
         if (pen_fd < 0)
             return false;
 
-        uinputPens[handle] = pen_fd;
+        getDeviceContext(handle)->pen.fd = pen_fd;
     }
 
     return true;
@@ -27,7 +27,7 @@ public:
     artist_pro_16tp();
 
     // Override only the methods that need custom behavior
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId) override;
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId) override;
     bool attachDevice(libusb_device_handle *handle, int interfaceId, int productId) override;
 };
 
@@ -0,0 +1,211 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include "control_transfer.h"
+#include "vendor_handler.h"
+#include "socket_server.h"
+
+control_transfer::control_transfer(vendor_handler* vendorHandler, libusb_device_handle* handle, const unix_socket_message* message) {
+    this->vendorHandler = vendorHandler;
+    this->handle = handle;
+
+    // The message is freed once it has been handed to every device so we keep our own copy of it
+    request = *message;
+    request.data = nullptr;
+    if (message->length > 0 && message->data != nullptr) {
+        requestData.assign(message->data, message->data + message->length);
+    }
+
+    transfer = nullptr;
+    stage = control_transfer_stage::sendRequest;
+    inFlight = false;
+    cancelled = false;
+    succeeded = false;
+}
+
+control_transfer::~control_transfer() {
+    if (transfer != nullptr) {
+        libusb_free_transfer(transfer);
+    }
+}
+
+bool control_transfer::submit() {
+    transfer = libusb_alloc_transfer(0);
+    if (transfer == NULL) {
+        std::cout << "Could not allocate a transfer for message on interface " << request.interface << std::endl;
+        return false;
+    }
+
+    libusb_fill_interrupt_transfer(transfer,
+                                   handle, request.interface | LIBUSB_ENDPOINT_OUT,
+                                   requestData.data(), requestData.size(),
+                                   transferCallback, this,
+                                   1000);
+
+    int ret = libusb_submit_transfer(transfer);
+    if (ret != LIBUSB_SUCCESS) {
+        std::cout << "Failed to send message on interface " << request.interface << " ret: " << ret << std::endl;
+        return false;
+    }
+
+    inFlight = true;
+    return true;
+}
+
+bool control_transfer::receive() {
+    if (request.responseLength <= 0) {
+        return false;
+    }
+
+    stage = control_transfer_stage::receiveResponse;
+    responseData.resize(request.responseLength);
+    libusb_fill_interrupt_transfer(transfer,
+                                   handle, request.responseInterface | LIBUSB_ENDPOINT_IN,
+                                   responseData.data(), responseData.size(),
+                                   transferCallback, this,
+                                   1000);
+
+    int ret = libusb_submit_transfer(transfer);
+    if (ret != LIBUSB_SUCCESS) {
+        std::cout << "Could not receive response on interface " << request.responseInterface << " ret: " << ret << std::endl;
+        return false;
+    }
+
+    inFlight = true;
+    return true;
+}
+
+void control_transfer::handleResponse(const unsigned char *data, int length) {
+    if (length != request.responseLength) {
+        std::cout << "Got a response of " << length << " bytes. Expected " << request.responseLength << std::endl;
+        finish(false);
+        return;
+    }
+
+    responseData.assign(data, data + length);
+    finish(true);
+}
+
+void control_transfer::cancel() {
+    if (stage == control_transfer_stage::finished) {
+        return;
+    }
+
+    cancelled = true;
+    if (inFlight) {
+        libusb_cancel_transfer(transfer);
+    } else {
+        // Only waiting on a ring so there is nothing libusb has to hand back
+        finish(false);
+    }
+}
+
+libusb_device_handle* control_transfer::getHandle() const {
+    return handle;
+}
+
+unsigned long control_transfer::getRequestId() const {
+    return request.requestId;
+}
+
+unsigned char control_transfer::getResponseEndpoint() const {
+    return request.responseInterface | LIBUSB_ENDPOINT_IN;
+}
+
+control_transfer_stage control_transfer::getStage() const {
+    return stage;
+}
+
+bool control_transfer::isIdle() const {
+    return !inFlight;
+}
+
+unix_socket_message* control_transfer::createResponse(unix_socket_message_queue* queue) const {
+    if (!succeeded || !request.expectResponse) {
+        return nullptr;
+    }
+
+    unix_socket_message* response = queue->createMessage(responseData.size());
+    response->destination = message_destination::gui;
+    response->vendor = request.vendor;
+    response->device = request.device;
+    response->interface = request.interface;
+    response->originatingSocket = request.originatingSocket;
+    response->signature = socket_server::versionSignature;
+    response->requestId = request.requestId;
+    std::copy(responseData.begin(), responseData.end(), response->data);
+
+    return response;
+}
+
+void control_transfer::transferCallback(struct libusb_transfer *transfer) {
+    auto control = (control_transfer*)transfer->user_data;
+    control->handleCompletion();
+}
+
+void control_transfer::handleCompletion() {
+    inFlight = false;
+
+    if (cancelled) {
+        finish(false);
+        return;
+    }
+
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        std::cout << "Message on interface " << request.interface << " failed with status " << transfer->status << std::endl;
+        finish(false);
+        return;
+    }
+
+    if (stage == control_transfer_stage::receiveResponse) {
+        // Our own transfer reads straight into the response buffer
+        if (transfer->actual_length != request.responseLength) {
+            std::cout << "Got a response of " << transfer->actual_length << " bytes. Expected " << request.responseLength << std::endl;
+            finish(false);
+            return;
+        }
+
+        finish(true);
+        return;
+    }
+
+    if (transfer->actual_length != request.length) {
+        std::cout << "Didn't send all of the message on interface " << request.interface << " only sent " << transfer->actual_length << std::endl;
+        finish(false);
+        return;
+    }
+
+    if (!request.expectResponse) {
+        finish(true);
+        return;
+    }
+
+    stage = control_transfer_stage::awaitResponse;
+    if (!vendorHandler->awaitControlResponse(this)) {
+        finish(false);
+    }
+}
+
+void control_transfer::finish(bool success) {
+    stage = control_transfer_stage::finished;
+    succeeded = success;
+
+    // The handler frees us so nothing may touch this object afterwards
+    vendorHandler->finishControlTransfer(this);
+}
@@ -0,0 +1,79 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_CONTROL_TRANSFER_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_CONTROL_TRANSFER_H
+
+#include <vector>
+#include <libusb-1.0/libusb.h>
+#include "unix_socket_message_queue.h"
+
+class vendor_handler;
+
+enum control_transfer_stage {
+    sendRequest = 0,
+    awaitResponse,
+    receiveResponse,
+    finished
+};
+
+// A GUI message on its way to one device. The request goes out on its own OUT transfer and, if the GUI wants an
+// answer, the response is either handed over by the ring already reading that endpoint or read with a transfer of
+// our own. All of it runs on the libusb event loop next to the report stream of the device instead of stopping it.
+class control_transfer {
+public:
+    control_transfer(vendor_handler* vendorHandler, libusb_device_handle* handle, const unix_socket_message* message);
+    ~control_transfer();
+
+    bool submit();
+    // Reads the response with our own transfer when no ring is reading the response endpoint
+    bool receive();
+    // Called by the ring reading the response endpoint with the first report after the request went out
+    void handleResponse(const unsigned char* data, int length);
+    // Finishes the request without a response. Anything in flight finishes once libusb hands it back.
+    void cancel();
+
+    libusb_device_handle* getHandle() const;
+    unsigned long getRequestId() const;
+    unsigned char getResponseEndpoint() const;
+    control_transfer_stage getStage() const;
+    bool isIdle() const;
+
+    // The message for the GUI, or nullptr if it didn't ask for one or the device didn't answer
+    unix_socket_message* createResponse(unix_socket_message_queue* queue) const;
+
+private:
+    static void LIBUSB_CALL transferCallback(struct libusb_transfer* transfer);
+    void handleCompletion();
+    void finish(bool success);
+
+    vendor_handler* vendorHandler;
+    libusb_device_handle* handle;
+    unix_socket_message request;
+    std::vector<unsigned char> requestData;
+    std::vector<unsigned char> responseData;
+
+    libusb_transfer* transfer;
+    control_transfer_stage stage;
+    bool inFlight;
+    bool cancelled;
+    bool succeeded;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_CONTROL_TRANSFER_H
@@ -20,14 +20,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <iomanip>
 
+static constexpr report_layout decoLayout = xpPenReportLayout.withButtons(2, 1).withWheel(7, 0x01, 0x02);
+
 deco::deco() {
     // Create a device specification for Deco devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = true;
     spec.hasHorizontalDial = true;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = decoLayout;
     
     // Initialize the base class with the specification
     deviceSpec = spec;
@@ -39,16 +40,6 @@ deco::deco() {
     registerProduct(0, "Unknown XP-Pen Device");
 }
 
-bool deco::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleGenericFrameEvent(handle, data, dataLen, deviceSpec.buttonByteIndex, deviceSpec.dialByteIndex);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+bool deco::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<decoLayout>(context, data, dataLen);
 }
@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "deco_02.h"
 
+static constexpr report_layout deco02Layout = xpPenReportLayout.withButtons(2, 1);
+
 deco_02::deco_02() {
     // Create a device specification for Deco 02 devices
     device_specification spec;
     spec.numButtons = 6;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = deco02Layout;
     
     // Register product IDs and names
     spec.addProduct(0x0803, "XP-Pen Deco 02");
@@ -47,38 +48,21 @@ deco_02::deco_02() {
     applyDefaultConfig(true);
 }
 
-bool deco_02::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
+bool deco_02::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
     switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            
-            // Use the generic frame event handler for button events
-            if (data[1] >= 0xf0) {
-                long button = data[deviceSpec.buttonByteIndex];
-                long position = ffsl(button);
-
-                if (button != 0) {
-                    handlePadButtonPressed(handle, position);
-                } else {
-                    handlePadButtonUnpressed(handle);
-                }
-
-                uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-            }
-            break;
-
         case 0x03:
-            handleNonUnifiedDialEvent(handle, data, dataLen);
+            handleNonUnifiedDialEvent(context, data, dataLen);
             break;
 
         default:
+            decodeReport<deco02Layout>(context, data, dataLen);
             break;
     }
 
     return true;
 }
 
-void deco_02::handleNonUnifiedDialEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void deco_02::handleNonUnifiedDialEvent(device_context* context, unsigned char *data, size_t dataLen) {
     if (data[1] == 0x01) {
         // Take the dial
         short dialValue = 0;
@@ -97,7 +81,7 @@ void deco_02::handleNonUnifiedDialEvent(libusb_device_handle *handle, unsigned c
         }
 
         if (dialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, dialValue);
+            handleDialEvent(context, REL_WHEEL, dialValue);
         }
     }
 }
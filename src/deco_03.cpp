@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "deco_03.h"
 
+static constexpr report_layout deco03Layout = xpPenReportLayout.withButtons(2, 1);
+
 deco_03::deco_03() {
     // Create a device specification for deco_03 devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = deco03Layout;
     
     // Register product IDs and names
     spec.addProduct(0x0904, "XP-Pen Deco 03");
@@ -47,41 +48,21 @@ deco_03::deco_03() {
     applyDefaultConfig(true);
 }
 
-bool deco_03::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
+bool deco_03::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
     switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
         case 0x03:
-            handleNonUnifiedDialEvent(handle, data, dataLen);
+            handleNonUnifiedDialEvent(context, data, dataLen);
             break;
 
         default:
+            decodeReport<deco03Layout>(context, data, dataLen);
             break;
     }
 
     return true;
 }
 
-void deco_03::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        long button = data[2];
-        // Only 8 buttons on this device
-        long position = ffsl(data[2]);
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else {
-            handlePadButtonUnpressed(handle);
-        }
-
-        uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-    }
-}
-
-void deco_03::handleNonUnifiedDialEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void deco_03::handleNonUnifiedDialEvent(device_context* context, unsigned char *data, size_t dataLen) {
     if (data[1] == 0x01) {
         std::bitset<8> dialBits(data[2]);
 
@@ -94,7 +75,7 @@ void deco_03::handleNonUnifiedDialEvent(libusb_device_handle *handle, unsigned c
         }
 
         if (dialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, dialValue);
+            handleDialEvent(context, REL_WHEEL, dialValue);
         }
     }
 }
@@ -27,12 +27,10 @@ public:
     deco_03();
 
     // Override only the methods that need custom behavior
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId) override;
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId) override;
 private:
     // Helper method for handling non-unified dial events
-    void handleNonUnifiedDialEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
-    // Helper method for handling frame events
-    void handleFrameEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
+    void handleNonUnifiedDialEvent(device_context* context, unsigned char* data, size_t dataLen);
 };
 
 
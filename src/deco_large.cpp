@@ -18,14 +18,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include "deco_large.h"
+
+static constexpr report_layout decoLargeLayout = xpPenReportLayout.withButtons(2, 1).withWheel(7, 0x01, 0x02);
 deco_large::deco_large() {
     // Create a device specification for deco_large devices
     device_specification spec;
     spec.numButtons = 0;
     spec.hasDial = false;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = decoLargeLayout;
     
     // Register product IDs and names
     spec.addProduct(0x0935, "XP-Pen Deco Large");
@@ -49,18 +50,6 @@ deco_large::deco_large() {
 void deco_large::setOffsetPressure(int productId) {
     offsetPressure = -8192;
 }
-bool deco_large::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            // Use the generic frame event handler
-            handleGenericFrameEvent(handle, data, dataLen, deviceSpec.buttonByteIndex, deviceSpec.dialByteIndex);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+bool deco_large::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<decoLargeLayout>(context, data, dataLen);
 }
-
@@ -27,7 +27,7 @@ public:
     deco_large();
 
     // Override only the methods that need custom behavior
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId) override;
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId) override;
     void setOffsetPressure(int productId) override;
 };
 
@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "deco_mini7.h"
 
+static constexpr report_layout decoMini7Layout = xpPenReportLayout.withButtons(2, 1);
+
 deco_mini7::deco_mini7() {
     // Create a device specification for deco_mini7 devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = false;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = decoMini7Layout;
     
     // Register product IDs and names
     spec.addProduct(0x0084, "XP-Pen Deco mini7");
@@ -47,32 +48,6 @@ deco_mini7::deco_mini7() {
     applyDefaultConfig(false);
 }
 
-bool deco_mini7::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
-}
-
-void deco_mini7::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        long button = data[2];
-        // Only 8 buttons on this device
-        long position = ffsl(data[2]);
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else {
-            handlePadButtonUnpressed(handle);
-        }
-
-        uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-    }
+bool deco_mini7::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<decoMini7Layout>(context, data, dataLen);
 }
@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "deco_pro_medium.h"
 
+static constexpr report_layout decoProMediumLayout = xpPenReportLayout.withButtons(2, 1).withWheel(7, 0x01, 0x02);
+
 deco_pro_medium::deco_pro_medium() {
     // Create a device specification for deco_pro_medium devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = true;
     spec.hasHorizontalDial = true;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = decoProMediumLayout;
     
     // Register product IDs and names
     spec.addProduct(0x0908, "XP-Pen Deco Pro Medium");
@@ -47,17 +48,6 @@ deco_pro_medium::deco_pro_medium() {
     applyDefaultConfig(true);
 }
 
-bool deco_pro_medium::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            // Use the generic frame event handler
-            handleGenericFrameEvent(handle, data, dataLen, deviceSpec.buttonByteIndex, deviceSpec.dialByteIndex);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+bool deco_pro_medium::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<decoProMediumLayout>(context, data, dataLen);
 }
@@ -0,0 +1,56 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_ATTACH_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_ATTACH_H
+
+#include <libusb-1.0/libusb.h>
+#include <vector>
+#include "device_interface_pair.h"
+#include "probe_cache.h"
+
+enum device_attach_stage {
+    probe = 0,
+    detachKernelDriver,
+    claim,
+    queryDescriptors,
+    createUinput,
+    submitTransfers,
+    attached
+};
+
+// An attach that is still working its way through the stages above. Each stage runs on its own turn of the
+// event loop and a failure schedules a retry from the start instead of sleeping.
+struct device_attach {
+public:
+    unsigned long id;
+    libusb_device* device;
+    struct libusb_device_descriptor descriptor;
+    struct libusb_config_descriptor* configDescriptor;
+    device_interface_pair* interfacePair;
+    device_attach_stage stage;
+    int productId;
+    int attempt;
+    // Results of earlier probes of whatever is plugged into this port
+    probe_record* probe;
+
+    // Interfaces that accepted the report protocol and idle setup and so get transfers
+    std::vector<unsigned char> configuredInterfaces;
+};
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_ATTACH_H
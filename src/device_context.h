@@ -0,0 +1,66 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_CONTEXT_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_CONTEXT_H
+
+#include <string>
+#include <libusb-1.0/libusb.h>
+#include "uinput_event_frame.h"
+#include "uinput_state_cache.h"
+#include "latency_histogram.h"
+
+struct probe_record;
+
+// A single virtual uinput device along with the frame being built for it and what it has already been sent
+struct uinput_device {
+public:
+    int fd = -1;
+    uinput_event_frame frame;
+    uinput_state_cache state;
+};
+
+// Everything a transfer handler needs to know about one attached physical device. It is resolved once when the
+// transfers are set up and handed to every handler method so nothing has to be looked up per event.
+struct device_context {
+public:
+    // Per report state is kept together at the front so decoding a report only touches one cache line of it
+    bool penInProximity = false;
+    bool eraserInProximity = false;
+    bool penWasDown = false;
+    short touchStripLastValue = -1;
+    int stylusButtonPressed = 0;
+    long lastPressedButton = -1;
+
+    libusb_device_handle* handle = nullptr;
+
+    // Read once on attach so identifying the device again doesn't cost another control transfer
+    std::string firmwareName;
+    bool firmwareRead = false;
+    // Probe results kept from the last time this device was plugged in, if any
+    probe_record* probe = nullptr;
+
+    uinput_device pen;
+    uinput_device pad;
+    uinput_device pointer;
+
+    // Time from the transfer completing to its events being written out
+    latency_histogram latency;
+};
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_CONTEXT_H
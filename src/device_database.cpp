@@ -0,0 +1,292 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <iostream>
+#include "device_database.h"
+
+// Ids and masks may be written as numbers or as "0x" prefixed strings since that's how they appear everywhere else
+static bool readNumber(const nlohmann::json& json, int& value) {
+    if (json.is_number_integer()) {
+        value = json.get<int>();
+        return true;
+    }
+
+    if (json.is_string()) {
+        try {
+            value = std::stoi(json.get<std::string>(), nullptr, 0);
+            return true;
+        } catch (std::exception&) {
+        }
+    }
+
+    return false;
+}
+
+// Fields are read as an int by the decoder, and offsets past the end of a packet would read outside the transfer
+// buffer, so anything that doesn't fit is an error rather than something to clamp
+static bool readField(const nlohmann::json& json, const char* key, int maxPacketSize, report_field& field) {
+    if (!json.contains(key)) {
+        return true;
+    }
+
+    int offset;
+    int width;
+    if (!json[key].is_array() || json[key].size() != 2 || !readNumber(json[key][0], offset) ||
+        !readNumber(json[key][1], width)) {
+        std::cout << "Layout field " << key << " should be [offset, width]" << std::endl;
+        return false;
+    }
+
+    if (width < 0 || width * 8 > 32) {
+        std::cout << "Layout field " << key << " is wider than 32 bits" << std::endl;
+        return false;
+    }
+
+    if (offset < 0 || offset + width > maxPacketSize) {
+        std::cout << "Layout field " << key << " at " << offset << " with width " << width
+                  << " does not fit a " << maxPacketSize << " byte packet" << std::endl;
+        return false;
+    }
+
+    field = {(uint8_t)offset, (uint8_t)width};
+    return true;
+}
+
+static void readByte(const nlohmann::json& json, const char* key, uint8_t& byte) {
+    int value;
+    if (json.contains(key) && readNumber(json[key], value)) {
+        byte = (uint8_t)value;
+    }
+}
+
+static bool readStatusBit(const nlohmann::json& json, const char* key, const report_field& status, uint8_t& bit) {
+    readByte(json, key, bit);
+    if (bit >= status.width * 8) {
+        std::cout << "Status bit " << key << " is outside the status field" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+device_database::device_database() {
+    loaded = false;
+}
+
+std::string device_database::getDefaultPath() {
+    return "/usr/share/userspace_tablet_driver_daemon/devices.json";
+}
+
+bool device_database::load(const std::string& databasePath) {
+    path = databasePath;
+
+    std::ifstream databaseFile(path, std::ifstream::in);
+    if (!databaseFile.is_open()) {
+        std::cout << "Could not open the device database " << path << std::endl;
+        return false;
+    }
+
+    nlohmann::json databaseJson;
+    try {
+        databaseFile >> databaseJson;
+    } catch (const nlohmann::detail::parse_error& error) {
+        std::cout << "Could not parse the device database " << path << ": " << error.what() << std::endl;
+        return false;
+    }
+
+    return load(databaseJson, databasePath);
+}
+
+bool device_database::load(const nlohmann::json& databaseJson, const std::string& source) {
+    path = source;
+
+    if (!databaseJson.contains("devices") || !databaseJson["devices"].is_array()) {
+        std::cout << "Device database " << path << " has no devices" << std::endl;
+        return false;
+    }
+
+    entries.reserve(databaseJson["devices"].size());
+    for (auto& deviceJson : databaseJson["devices"]) {
+        device_entry entry;
+        if (!parseEntry(deviceJson, entry)) {
+            std::cout << "Skipping invalid device database entry " << deviceJson << std::endl;
+            continue;
+        }
+
+        if (findProduct(entry.vendorId, entry.productId) != nullptr) {
+            std::cout << "Skipping duplicate device database entry for " << std::hex << entry.vendorId << ":"
+                      << entry.productId << std::dec << std::endl;
+            continue;
+        }
+
+        size_t index = entries.size();
+        productIndex[productKey(entry.vendorId, entry.productId)] = index;
+        for (auto& firmware : entry.firmware) {
+            if (!firmwareIndex.add(entry.vendorId, firmware, index)) {
+                std::cout << "Firmware " << firmware << " is listed for more than one device" << std::endl;
+            }
+        }
+
+        entries.push_back(entry);
+    }
+
+    firmwareIndex.build();
+
+    loaded = true;
+    std::cout << "Loaded " << entries.size() << " devices from " << path << std::endl;
+
+    return true;
+}
+
+bool device_database::parseEntry(const nlohmann::json& json, device_entry& entry) {
+    int vendorId;
+    int productId;
+    if (!json.is_object() || !json.contains("vendor") || !json.contains("product") ||
+        !readNumber(json["vendor"], vendorId) || !readNumber(json["product"], productId)) {
+        return false;
+    }
+
+    if (!json.contains("name") || !json["name"].is_string() || !json.contains("driver") || !json["driver"].is_string()) {
+        return false;
+    }
+
+    entry.vendorId = vendorId;
+    entry.productId = productId;
+    entry.name = json["name"];
+    entry.driver = json["driver"];
+
+    if (json.contains("firmware") && json["firmware"].is_array()) {
+        for (auto& firmware : json["firmware"]) {
+            if (firmware.is_string()) {
+                entry.firmware.push_back(firmware);
+            }
+        }
+    }
+
+    entry.spec.addProduct(entry.productId, entry.name);
+
+    if (json.contains("buttons") && json["buttons"].is_number_integer()) {
+        entry.spec.numButtons = json["buttons"];
+    }
+
+    if (json.contains("dial") && json["dial"].is_boolean()) {
+        entry.spec.hasDial = json["dial"];
+    }
+
+    if (json.contains("horizontalDial") && json["horizontalDial"].is_boolean()) {
+        entry.spec.hasHorizontalDial = json["horizontalDial"];
+    }
+
+    if (json.contains("layout") && json["layout"].is_object() && !parseLayout(json["layout"], entry.spec.layout)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool device_database::parseLayout(const nlohmann::json& json, report_layout& layout) {
+    // Full speed interrupt endpoints can't send more than this, which is all the XP-Pen devices we know of
+    int maxPacketSize = 64;
+    if (json.contains("maxPacketSize") && (!readNumber(json["maxPacketSize"], maxPacketSize) || maxPacketSize <= 0)) {
+        return false;
+    }
+
+    // Anything left out keeps the value of the standard XP-Pen report
+    readByte(json, "reportId", layout.reportId);
+    readByte(json, "maxDigitizerStatus", layout.maxDigitizerStatus);
+    readByte(json, "minFrameStatus", layout.minFrameStatus);
+    readByte(json, "xHighReportLength", layout.xHighReportLength);
+    readByte(json, "wheelUpMask", layout.wheelUpMask);
+    readByte(json, "wheelDownMask", layout.wheelDownMask);
+    readByte(json, "hWheelUpMask", layout.hWheelUpMask);
+    readByte(json, "hWheelDownMask", layout.hWheelDownMask);
+
+    bool valid = readField(json, "status", maxPacketSize, layout.status) &&
+                 readField(json, "x", maxPacketSize, layout.x) &&
+                 readField(json, "y", maxPacketSize, layout.y) &&
+                 readField(json, "xHigh", maxPacketSize, layout.xHigh) &&
+                 readField(json, "pressure", maxPacketSize, layout.pressure) &&
+                 readField(json, "tiltX", maxPacketSize, layout.tiltX) &&
+                 readField(json, "tiltY", maxPacketSize, layout.tiltY) &&
+                 readField(json, "buttons", maxPacketSize, layout.buttons) &&
+                 readField(json, "dial", maxPacketSize, layout.dial);
+    if (!valid) {
+        return false;
+    }
+
+    // The status field decides whether a report is pen or pad data, so the decoder can't do without it
+    if (!layout.status.present()) {
+        std::cout << "Layout has no status field" << std::endl;
+        return false;
+    }
+
+    if (layout.xHigh.present() && layout.xHigh.end() > layout.xHighReportLength) {
+        std::cout << "Layout field xHigh does not fit a " << (int)layout.xHighReportLength << " byte report" << std::endl;
+        return false;
+    }
+
+    return readStatusBit(json, "tipBit", layout.status, layout.tipBit) &&
+           readStatusBit(json, "barrelBit", layout.status, layout.barrelBit) &&
+           readStatusBit(json, "secondBarrelBit", layout.status, layout.secondBarrelBit) &&
+           readStatusBit(json, "eraserBit", layout.status, layout.eraserBit) &&
+           readStatusBit(json, "outOfRangeBit", layout.status, layout.outOfRangeBit) &&
+           readStatusBit(json, "inRangeBit", layout.status, layout.inRangeBit) &&
+           readStatusBit(json, "leavingBit", layout.status, layout.leavingBit);
+}
+
+bool device_database::isLoaded() const {
+    return loaded;
+}
+
+const std::string& device_database::getPath() const {
+    return path;
+}
+
+uint32_t device_database::productKey(unsigned short vendorId, unsigned short productId) {
+    return ((uint32_t)vendorId << 16) | productId;
+}
+
+const device_entry* device_database::findProduct(unsigned short vendorId, unsigned short productId) const {
+    auto entry = productIndex.find(productKey(vendorId, productId));
+    if (entry == productIndex.end()) {
+        return nullptr;
+    }
+
+    return &entries[entry->second];
+}
+
+const device_entry* device_database::findFirmware(unsigned short vendorId, std::string_view firmware) const {
+    long index = firmwareIndex.find(vendorId, firmware);
+    if (index == -1) {
+        return nullptr;
+    }
+
+    return &entries[index];
+}
+
+std::vector<const device_entry*> device_database::getVendorEntries(unsigned short vendorId) const {
+    std::vector<const device_entry*> vendorEntries;
+    for (auto& entry : entries) {
+        if (entry.vendorId == vendorId) {
+            vendorEntries.push_back(&entry);
+        }
+    }
+
+    return vendorEntries;
+}
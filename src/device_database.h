@@ -0,0 +1,75 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_DATABASE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_DATABASE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "includes/json.hpp"
+#include "device_specification.h"
+#include "firmware_table.h"
+
+struct device_entry {
+    unsigned short vendorId;
+    unsigned short productId;
+    std::string name;
+    // Which transfer handler decodes the device. "generic" builds one from the spec alone
+    std::string driver;
+    // Firmware strings reported by devices that share a product id and are told apart by their firmware. Later builds
+    // of the same model match on everything before the date suffix
+    std::vector<std::string> firmware;
+    device_specification spec;
+};
+
+// The tablets we know about, read from devices.json once on startup. Nothing is added or removed after loading so
+// the tables can be read from any thread without locking, and every lookup is a single hash probe.
+class device_database {
+public:
+    device_database();
+
+    bool load(const std::string& path);
+    // Source only names the entries in log messages
+    bool load(const nlohmann::json& databaseJson, const std::string& source);
+    bool isLoaded() const;
+    const std::string& getPath() const;
+
+    const device_entry* findProduct(unsigned short vendorId, unsigned short productId) const;
+    const device_entry* findFirmware(unsigned short vendorId, std::string_view firmware) const;
+    // Every entry of a vendor in the order they appear in the file
+    std::vector<const device_entry*> getVendorEntries(unsigned short vendorId) const;
+
+    static std::string getDefaultPath();
+private:
+    bool parseEntry(const nlohmann::json& json, device_entry& entry);
+    bool parseLayout(const nlohmann::json& json, report_layout& layout);
+
+    static uint32_t productKey(unsigned short vendorId, unsigned short productId);
+
+    std::string path;
+    bool loaded;
+
+    std::vector<device_entry> entries;
+    std::unordered_map<uint32_t, size_t> productIndex;
+    firmware_table firmwareIndex;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_DEVICE_DATABASE_H
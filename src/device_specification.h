@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include <map>
 #include <vector>
+#include "report_layout.h"
 
 struct device_specification {
     // Product information
@@ -33,17 +34,15 @@ struct device_specification {
     bool hasDial;
     bool hasHorizontalDial;
     
-    // Frame event handling
-    int buttonByteIndex;
-    int dialByteIndex;
+    // Where the pen and pad fields are in the reports
+    report_layout layout;
     
     // Constructor with default values
     device_specification() : 
         numButtons(0),
         hasDial(false),
         hasHorizontalDial(false),
-        buttonByteIndex(2),
-        dialByteIndex(7) {}
+        layout(xpPenReportLayout) {}
     
     // Add a product ID and name
     void addProduct(int productId, const std::string& name) {
@@ -16,36 +16,35 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <linux/input.h>
+#include <cstdlib>
 #include "dial_mapping.h"
-#include <iostream>
 
-dial_mapping::dial_mapping() {
+dial_mapping::dial_mapping() : eventDialMap(REL_CNT * (2 * maxDirection + 1)) {
 
 }
 
-std::vector<aliased_input_event> dial_mapping::getDialMap(int eventCode, int value, int data) {
-    auto record = eventDialMap.find(value);
-    if (record != eventDialMap.end()) {
-        std::string strvalue = std::to_string(data);
-        auto value = record->second.find(strvalue);
-        if (value != record->second.end()) {
-            return value->second;
-        }
+int dial_mapping::dialKey(int dial, int direction) {
+    if (dial < 0 || dial >= REL_CNT || direction < -maxDirection || direction > maxDirection) {
+        return -1;
     }
 
-    std::vector<aliased_input_event> temp;
-    aliased_input_event tempEvent {
+    return dial * (2 * maxDirection + 1) + (direction + maxDirection);
+}
+
+aliased_input_event_view dial_mapping::getDialMap(int eventCode, int value, int data) {
+    aliased_input_event_view view;
+    if (eventDialMap.find(dialKey(value, data), view)) {
+        return view;
+    }
+
+    fallbackEvent = aliased_input_event {
         eventCode, value, data
     };
-    temp.push_back(tempEvent);
 
-    return temp;
+    return aliased_input_event_view { &fallbackEvent, 1 };
 }
 
 void dial_mapping::setDialMap(int eventCode, std::string value, const std::vector<aliased_input_event> &events) {
-    if (eventDialMap.find(eventCode) == eventDialMap.end()) {
-        eventDialMap[eventCode] = std::map<std::string, std::vector<aliased_input_event> >();
-    }
-
-    eventDialMap[eventCode][value] = events;
+    eventDialMap.set(dialKey(eventCode, std::atoi(value.c_str())), events);
 }
@@ -20,18 +20,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define USERSPACE_TABLET_DRIVER_DAEMON_DIAL_MAPPING_H
 
 #include <vector>
-#include <map>
 #include <string>
 #include "aliased_input_event.h"
+#include "aliased_input_event_table.h"
 
 class dial_mapping {
 public:
     dial_mapping();
 
-    std::vector<aliased_input_event> getDialMap(int eventCode, int value, int data);
+    aliased_input_event_view getDialMap(int eventCode, int value, int data);
     void setDialMap(int eventCode, std::string value, const std::vector<aliased_input_event> &events);
 private:
-    std::map<int, std::map<std::string, std::vector<aliased_input_event> > > eventDialMap;
+    // Dials only ever report small steps so (dial code, direction) packs into a dense integer key
+    static const int maxDirection = 8;
+    static int dialKey(int dial, int direction);
+
+    aliased_input_event_table eventDialMap;
+    // Unmapped dial movements are passed through as themselves
+    aliased_input_event fallbackEvent;
 };
 
 
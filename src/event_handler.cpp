@@ -28,6 +28,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <csignal>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 #include <iostream>
 #include <fstream>
 #include "event_handler.h"
@@ -45,11 +49,28 @@ event_handler::event_handler() {
     }
 
     instance = this;
+    signalFd = -1;
+    hotplugFd = -1;
+    devicePool = nullptr;
     devices = new usb_devices();
 
     loadConfiguration();
-    addHandler(new xp_pen_handler());
-    addHandler(new huion_handler());
+
+    // Devices are created on the sink as soon as they attach so it can't be swapped at runtime
+    inputSink = input_sink::create(driverConfigJson["inputSink"]);
+    std::cout << "Using the " << inputSink->name() << " input sink" << std::endl;
+    usbThread.setInputSink(inputSink);
+
+    devicePool = new uinput_device_pool(inputSink);
+    devicePool->setGracePeriod(driverConfigJson["uinputGracePeriodSeconds"]);
+    devicePool->setReactor(&reactor);
+    devicePool->setUsbThread(&usbThread);
+
+    // The handlers are built from the database so like the sink it is only read on startup
+    deviceDatabase.load(driverConfigJson["deviceDatabase"]);
+
+    addHandler(new xp_pen_handler(deviceDatabase));
+    addHandler(new huion_handler(deviceDatabase));
     saveConfiguration();
 }
 
@@ -60,9 +81,64 @@ event_handler::~event_handler() {
     }
 
     delete devices;
+    // Parked devices are destroyed on the sink so it has to go after them
+    delete devicePool;
+    delete inputSink;
+
+    if (signalFd != -1) {
+        close(signalFd);
+    }
+
+    if (hotplugFd != -1) {
+        close(hotplugFd);
+    }
 }
 
-void event_handler::sigHandler(int signo) {
+bool event_handler::setupSignalHandling() {
+    // Signals are delivered through a signalfd so that they wake the reactor and are handled on the main loop
+    // instead of inside an async signal handler
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        std::cout << "Could not block signals errno: " << errno << std::endl;
+        return false;
+    }
+
+    signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd == -1) {
+        std::cout << "Could not create signalfd errno: " << errno << std::endl;
+        return false;
+    }
+
+    return reactor.addFd(signalFd, EPOLLIN, [this](uint32_t events) {
+        struct signalfd_siginfo signalInfo;
+        while (read(signalFd, &signalInfo, sizeof(signalInfo)) == sizeof(signalInfo)) {
+            handleSignal(signalInfo.ssi_signo);
+        }
+    });
+}
+
+bool event_handler::setupHotplugHandling() {
+    // Hotplug callbacks fire on the usb thread. They only queue the event and poke this fd so the slow work of
+    // claiming a device happens on the control thread
+    hotplugFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (hotplugFd == -1) {
+        std::cout << "Could not create hotplug eventfd errno: " << errno << std::endl;
+        return false;
+    }
+
+    return reactor.addFd(hotplugFd, EPOLLIN, [this](uint32_t events) {
+        uint64_t count;
+        while (read(hotplugFd, &count, sizeof(count)) == sizeof(count)) {
+        }
+    });
+}
+
+void event_handler::handleSignal(int signo) {
     if (signo == SIGINT) {
         std::cout << "Caught SIGINT" << std::endl;
         running = false;
@@ -75,7 +151,7 @@ void event_handler::sigHandler(int signo) {
 
     if (signo == SIGHUP) {
         std::cout << "Reloading configuration" << std::endl;
-        instance->loadConfiguration();
+        loadConfiguration();
     }
 }
 
@@ -114,22 +190,73 @@ void event_handler::loadConfiguration() {
         driverConfigJson["deviceConfigurations"] = nlohmann::json({});
     }
 
+    // How many interrupt transfers are kept queued on every IN endpoint. Takes effect when transfers are next set up
+    if (!driverConfigJson.contains("transfersPerEndpoint") || !driverConfigJson["transfersPerEndpoint"].is_number_integer()) {
+        driverConfigJson["transfersPerEndpoint"] = 4;
+    }
+
+    // Scheduling of the usb thread. A priority of 1-99 requests SCHED_FIFO and a cpu of -1 leaves it unpinned.
+    // Both only take effect on startup
+    if (!driverConfigJson.contains("usbThreadPriority") || !driverConfigJson["usbThreadPriority"].is_number_integer()) {
+        driverConfigJson["usbThreadPriority"] = 0;
+    }
+
+    if (!driverConfigJson.contains("usbThreadCpu") || !driverConfigJson["usbThreadCpu"].is_number_integer()) {
+        driverConfigJson["usbThreadCpu"] = -1;
+    }
+
+    // When set every raw report is written to this file so it can be replayed later with tablet_replay
+    if (!driverConfigJson.contains("captureFile") || !driverConfigJson["captureFile"].is_string()) {
+        driverConfigJson["captureFile"] = "";
+    }
+
+    // How input events reach the kernel: "uinput", "io_uring" to batch writes or "memory" to discard them.
+    // Only takes effect on startup
+    if (!driverConfigJson.contains("inputSink") || !driverConfigJson["inputSink"].is_string()) {
+        driverConfigJson["inputSink"] = "uinput";
+    }
+
+    // The list of known tablets and how to decode them. Only takes effect on startup
+    if (!driverConfigJson.contains("deviceDatabase") || !driverConfigJson["deviceDatabase"].is_string()) {
+        driverConfigJson["deviceDatabase"] = device_database::getDefaultPath();
+    }
+
+    // How long the virtual devices of an unplugged tablet are kept for it to come back to. 0 closes them right away
+    if (!driverConfigJson.contains("uinputGracePeriodSeconds") || !driverConfigJson["uinputGracePeriodSeconds"].is_number_integer()) {
+        driverConfigJson["uinputGracePeriodSeconds"] = 10;
+    }
+
+    if (devicePool != nullptr) {
+        devicePool->setGracePeriod(driverConfigJson["uinputGracePeriodSeconds"]);
+    }
+
     // Upgrade the previous version of the config file if it exists
     if (driverConfigJson.contains("XP-Pen")) {
         driverConfigJson["deviceConfigurations"]["10429"] = nlohmann::json(driverConfigJson["XP-Pen"]);
         driverConfigJson.erase("XP-Pen");
     }
 
-    for(auto handler : vendorHandlers) {
-        auto vendorIdString = std::to_string(handler.second->getVendorId());
-        if (!driverConfigJson["deviceConfigurations"].contains(vendorIdString) ||
-            driverConfigJson["deviceConfigurations"][vendorIdString] == nullptr) {
-
-            driverConfigJson["deviceConfigurations"][vendorIdString] = nlohmann::json({});
+    // The handlers' mappings are read by every transfer callback so they are only swapped on the usb thread
+    usbThread.invoke([this]() {
+        std::string captureFile = driverConfigJson["captureFile"];
+        if (captureFile.empty()) {
+            capture.close();
+        } else {
+            capture.open(captureFile);
         }
 
-        handler.second->setConfig(driverConfigJson["deviceConfigurations"][vendorIdString]);
-    }
+        for (auto handler: vendorHandlers) {
+            auto vendorIdString = std::to_string(handler.second->getVendorId());
+            if (!driverConfigJson["deviceConfigurations"].contains(vendorIdString) ||
+                driverConfigJson["deviceConfigurations"][vendorIdString] == nullptr) {
+
+                driverConfigJson["deviceConfigurations"][vendorIdString] = nlohmann::json({});
+            }
+
+            handler.second->setTransfersPerEndpoint(driverConfigJson["transfersPerEndpoint"]);
+            handler.second->setConfig(driverConfigJson["deviceConfigurations"][vendorIdString]);
+        }
+    });
 }
 
 void event_handler::saveConfiguration() {
@@ -158,19 +285,66 @@ void event_handler::addHandler(vendor_handler *handler) {
         driverConfigJson["deviceConfigurations"][vendorIdString] = nlohmann::json({});
     }
 
+    handler->setTransfersPerEndpoint(driverConfigJson["transfersPerEndpoint"]);
     handler->setConfig(driverConfigJson["deviceConfigurations"][vendorIdString]);
     handler->setMessageQueue(&messageQueue);
+    handler->setUsbThread(&usbThread);
+    handler->setReactor(&reactor);
+    handler->setCapture(&capture);
+    handler->setInputSink(inputSink);
+    handler->setDevicePool(devicePool);
 }
 
 int event_handler::hotplugCallback(struct libusb_context* context, struct libusb_device* device,
                     libusb_hotplug_event event, void* user_data) {
     std::cout << "Got hotplug event" << std::endl;
     event_handler* eventHandler = (event_handler*)user_data;
-    eventHandler->hotplugEvents.push_back({event, device});
+
+    // libusb can free a device that has left as soon as this returns, so the control thread gets its own reference
+    libusb_ref_device(device);
+    if (!eventHandler->hotplugEvents.push({event, device})) {
+        std::cout << "Hotplug event queue is full, dropping event" << std::endl;
+        libusb_unref_device(device);
+        return 0;
+    }
+
+    uint64_t wake = 1;
+    if (write(eventHandler->hotplugFd, &wake, sizeof(wake)) != sizeof(wake)) {
+        std::cout << "Could not wake control thread errno: " << errno << std::endl;
+    }
     return 0;
 }
 
+void event_handler::handleHotplugEvents() {
+    hotplug_event event;
+    while (hotplugEvents.pop(event)) {
+        if (event.event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+            // This only starts the attach. Its stages are driven by timers on this loop
+            devices->handleDeviceAttach(vendorHandlers, event.device);
+        } else if (event.event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
+            usbThread.invoke([this, &event]() {
+                devices->handleDeviceDetach(vendorHandlers, event.device);
+            });
+        }
+
+        libusb_unref_device(event.device);
+    }
+}
+
 int event_handler::run() {
+    // Signals have to be blocked before the usb thread starts so that it inherits the mask and they all end up
+    // on the signalfd
+    if (!reactor.isValid() || !setupSignalHandling() || !setupHotplugHandling()) {
+        return 1;
+    }
+
+    socketServer.attachToReactor(&reactor, &messageQueue);
+
+    if (!usbThread.start(devices, driverConfigJson["usbThreadPriority"], driverConfigJson["usbThreadCpu"])) {
+        std::cout << "Could not start usb thread" << std::endl;
+        return 1;
+    }
+
     auto supportedDevices = devices->getCandidateDevices(vendorHandlers);
 
     std::vector<libusb_hotplug_callback_handle> callbackHandles;
@@ -187,30 +361,28 @@ int event_handler::run() {
         }
     }
 
-    signal(SIGINT, sigHandler);
-    signal(SIGTERM, sigHandler);
-    signal(SIGHUP, sigHandler);
-
     while (running) {
-        devices->handleEvents();
+        // Sleep until a hotplug event is handed over, an attach stage is due, a socket has data or we get a signal.
+        // USB transfers are serviced on the usb thread
+        reactor.wait(-1);
+
         // Handle all new device attach events
-        while (hotplugEvents.size() > 0) {
-            auto event = hotplugEvents.front();
-            if (event.event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
-                devices->handleDeviceAttach(vendorHandlers, event.device);
-            } else if (event.event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
-                devices->handleDeviceDetach(vendorHandlers, event.device);
-            }
-            hotplugEvents.pop_front();
-        }
+        handleHotplugEvents();
 
-        // Handle any new incoming socket communications
-        socketServer.handleConnections();
-        socketServer.handleMessages(&messageQueue);
+        // Have all the vendor handlers process messages. They reconfigure devices that are actively sending
+        // reports so this runs on the usb thread
+        if (messageQueue.hasMessagesFor(message_destination::driver)) {
+            usbThread.invoke([this]() {
+                for (auto handler: vendorHandlers) {
+                    handler.second->handleMessages();
+                }
 
-        // Have all the vendor handlers process messages
-        for (auto handler: vendorHandlers) {
-            handler.second->handleMessages();
+                // Nobody is going to pick up messages for a vendor we have no handler for
+                size_t unhandled = messageQueue.releaseMessagesFor(message_destination::driver);
+                if (unhandled > 0) {
+                    std::cout << "Dropped " << unhandled << " messages no handler took" << std::endl;
+                }
+            });
         }
 
         // Handle messages directed to the event handler
@@ -226,13 +398,22 @@ int event_handler::run() {
         libusb_hotplug_deregister_callback(NULL, callbackHandle);
     }
 
+    usbThread.stop();
+
+    // Hotplug callbacks run on the usb thread so nothing more can be queued. Drop the references still held
+    hotplug_event event;
+    while (hotplugEvents.pop(event)) {
+        libusb_unref_device(event.device);
+    }
+
     return 0;
 }
 
 void event_handler::handleMessages() {
-    auto messages = messageQueue.getMessagesFor(message_destination::eventHandler, 0x0000);
-    for (auto message : messages) {
-        auto response = new unix_socket_message;
+    // Runs on every turn of the loop so the vector is kept around instead of allocated each time
+    messageQueue.getMessagesFor(message_destination::eventHandler, 0x0000, receivedMessages);
+    for (auto message : receivedMessages) {
+        auto response = messageQueue.createMessage(4096);
         response->destination = message_destination::gui;
         response->vendor = message->vendor;
         response->device = message->device;
@@ -240,13 +421,13 @@ void event_handler::handleMessages() {
         response->length = message->responseLength;
         response->originatingSocket = message->originatingSocket;
         response->signature = socket_server::versionSignature;
+        response->requestId = message->requestId;
         unsigned char* writePointer = nullptr;
 
         switch (message->device) {
             // Get connected devices
             case 0x0001:
                 std::cout << "Handling get connected devices request" << std::endl;
-                response->data = new unsigned char[4096];
                 memset(response->data, 0, 4096);
                 writePointer = response->data;
                 for (auto handler: vendorHandlers) {
@@ -261,6 +442,7 @@ void event_handler::handleMessages() {
                 response->length = writePointer - response->data;
 
                 messageQueue.addMessage(response);
+                response = nullptr;
 
                 break;
 
@@ -270,8 +452,41 @@ void event_handler::handleMessages() {
 
                 break;
 
+            // Get per device latency from transfer completion to uinput write, in nanoseconds
+            case 0x0003:
+                std::cout << "Handling get latency histograms request" << std::endl;
+                memset(response->data, 0, 4096);
+                writePointer = response->data;
+                for (auto handler: vendorHandlers) {
+                    for (auto summary : handler.second->getLatencySummaries()) {
+                        const size_t entrySize = sizeof(summary.vendorId) + sizeof(summary.productId) + sizeof(uint64_t) * 5;
+                        if ((writePointer - response->data) + entrySize > 4096) {
+                            break;
+                        }
+
+                        memcpy(writePointer, &summary.vendorId, sizeof(summary.vendorId));
+                        writePointer+=sizeof(summary.vendorId);
+                        memcpy(writePointer, &summary.productId, sizeof(summary.productId));
+                        writePointer+=sizeof(summary.productId);
+                        for (auto value : {summary.count, summary.p50, summary.p99, summary.p999, summary.max}) {
+                            memcpy(writePointer, &value, sizeof(value));
+                            writePointer+=sizeof(value);
+                        }
+                    }
+                }
+                response->length = writePointer - response->data;
+
+                messageQueue.addMessage(response);
+                response = nullptr;
+
+                break;
+
             default:
                 break;
         }
+
+        // Requests without a response leave it unused
+        messageQueue.releaseMessage(response);
+        messageQueue.releaseMessage(message);
     }
 }
@@ -22,13 +22,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <libusb-1.0/libusb.h>
 #include <map>
-#include <deque>
 #include <fstream>
 #include "vendor_handler.h"
 #include "usb_devices.h"
 #include "hotplug_event.h"
 #include "includes/json.hpp"
 #include "socket_server.h"
+#include "event_reactor.h"
+#include "spsc_queue.h"
+#include "usb_event_thread.h"
+#include "report_capture.h"
+#include "input_sink.h"
+#include "uinput_device_pool.h"
+#include "device_database.h"
 
 class event_handler {
 public:
@@ -37,7 +43,10 @@ public:
     int run();
 
 private:
-    static void sigHandler(int signo);
+    void handleSignal(int signo);
+    bool setupSignalHandling();
+    bool setupHotplugHandling();
+    void handleHotplugEvents();
     static int hotplugCallback(struct libusb_context* context, struct libusb_device* device,
                                        libusb_hotplug_event event, void* user_data);
 
@@ -53,16 +62,28 @@ private:
     static bool running;
     static event_handler* instance;
 
+    device_database deviceDatabase;
     std::map<short, vendor_handler*> vendorHandlers;
     usb_devices *devices;
 
-    std::deque<hotplug_event> hotplugEvents;
+    // Filled by the hotplug callback on the usb thread and drained by the control thread
+    spsc_queue<hotplug_event, 64> hotplugEvents;
+    int hotplugFd;
 
     // Config related
     nlohmann::json driverConfigJson;
 
+    event_reactor reactor;
+    int signalFd;
+
+    usb_event_thread usbThread;
+    report_capture capture;
+    input_sink* inputSink;
+    uinput_device_pool* devicePool;
+
     socket_server socketServer;
     unix_socket_message_queue messageQueue;
+    std::vector<unix_socket_message*> receivedMessages;
 };
 
 
@@ -0,0 +1,138 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <iostream>
+#include "event_reactor.h"
+
+event_reactor::event_reactor() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        std::cout << "Could not create epoll instance errno: " << errno << std::endl;
+    }
+}
+
+event_reactor::~event_reactor() {
+    if (epollFd != -1) {
+        close(epollFd);
+    }
+}
+
+bool event_reactor::isValid() {
+    return epollFd != -1;
+}
+
+bool event_reactor::addFd(int fd, uint32_t events, fd_handler handler) {
+    struct epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        std::cout << "Could not add fd " << fd << " to epoll set errno: " << errno << std::endl;
+        return false;
+    }
+
+    handlers[fd] = handler;
+    return true;
+}
+
+bool event_reactor::modifyFd(int fd, uint32_t events) {
+    struct epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) != -1;
+}
+
+void event_reactor::removeFd(int fd) {
+    auto record = handlers.find(fd);
+    if (record != handlers.end()) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+        handlers.erase(record);
+    }
+}
+
+bool event_reactor::addTimer(int delayMs, std::function<void()> callback) {
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd == -1) {
+        std::cout << "Could not create timerfd errno: " << errno << std::endl;
+        return false;
+    }
+
+    // An all zero expiry disarms the timer so "now" is the next nanosecond
+    struct itimerspec expiry {};
+    expiry.it_value.tv_sec = delayMs / 1000;
+    expiry.it_value.tv_nsec = (delayMs % 1000) * 1000000L;
+    if (delayMs <= 0) {
+        expiry.it_value.tv_sec = 0;
+        expiry.it_value.tv_nsec = 1;
+    }
+
+    if (timerfd_settime(timerFd, 0, &expiry, NULL) == -1) {
+        std::cout << "Could not arm timerfd errno: " << errno << std::endl;
+        close(timerFd);
+        return false;
+    }
+
+    bool added = addFd(timerFd, EPOLLIN, [this, timerFd, callback](uint32_t events) {
+        uint64_t expirations;
+        if (read(timerFd, &expirations, sizeof(expirations)) == -1) {
+            return;
+        }
+
+        removeFd(timerFd);
+        close(timerFd);
+        callback();
+    });
+
+    if (!added) {
+        close(timerFd);
+    }
+
+    return added;
+}
+
+int event_reactor::wait(int timeoutMs) {
+    const int maxEvents = 32;
+    struct epoll_event events[maxEvents];
+
+    int ready = epoll_wait(epollFd, events, maxEvents, timeoutMs);
+    if (ready == -1) {
+        if (errno != EINTR) {
+            std::cout << "epoll_wait failed errno: " << errno << std::endl;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    for (int i = 0; i < ready; ++i) {
+        // Handlers are allowed to remove fds (including other ready ones) so look them up each time
+        auto record = handlers.find(events[i].data.fd);
+        if (record != handlers.end()) {
+            // Copy so the handler survives removing itself
+            fd_handler handler = record->second;
+            handler(events[i].events);
+        }
+    }
+
+    return ready;
+}
@@ -0,0 +1,54 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_EVENT_REACTOR_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_EVENT_REACTOR_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+
+// Thin wrapper around an epoll set. Every file descriptor we care about (libusb, sockets, signals) is registered
+// here so the main loop can block until something is actually ready instead of spinning.
+class event_reactor {
+public:
+    typedef std::function<void(uint32_t events)> fd_handler;
+
+    event_reactor();
+    ~event_reactor();
+
+    bool isValid();
+
+    bool addFd(int fd, uint32_t events, fd_handler handler);
+    bool modifyFd(int fd, uint32_t events);
+    void removeFd(int fd);
+
+    // Runs callback once from wait() after delayMs. Backed by a timerfd so it wakes the reactor like any other fd
+    bool addTimer(int delayMs, std::function<void()> callback);
+
+    // Blocks for up to timeoutMs (-1 for forever) and dispatches the handlers of every ready fd.
+    // Returns the number of ready fds, 0 on timeout or -1 on error.
+    int wait(int timeoutMs);
+
+private:
+    int epollFd;
+    std::map<int, fd_handler> handlers;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_EVENT_REACTOR_H
@@ -0,0 +1,202 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "firmware_table.h"
+
+firmware_table::firmware_table() {
+    slotMask = 0;
+    bucketMask = 0;
+}
+
+std::string_view firmware_table::modelPrefix(std::string_view firmware) {
+    auto dateSeparator = firmware.rfind('_');
+    if (dateSeparator == std::string_view::npos || dateSeparator == 0) {
+        return firmware;
+    }
+
+    return firmware.substr(0, dateSeparator);
+}
+
+bool firmware_table::add(unsigned short vendorId, const std::string& firmware, size_t index) {
+    for (auto& existing : keys) {
+        if (existing.vendorId == vendorId && existing.firmware == firmware && existing.exact && existing.index != index) {
+            return false;
+        }
+    }
+
+    insert(vendorId, firmware, index, true);
+
+    auto prefix = modelPrefix(firmware);
+    if (prefix.size() != firmware.size()) {
+        insert(vendorId, std::string(prefix), index, false);
+    }
+
+    return true;
+}
+
+void firmware_table::insert(unsigned short vendorId, const std::string& firmware, size_t index, bool exact) {
+    for (auto& existing : keys) {
+        if (existing.vendorId != vendorId || existing.firmware != firmware) {
+            continue;
+        }
+
+        if (existing.index == index) {
+            existing.exact |= exact;
+        } else if (exact && !existing.exact) {
+            // A firmware string that is listed outright always beats one derived from another device's firmware
+            existing.index = index;
+            existing.exact = true;
+            existing.ambiguous = false;
+        } else if (!exact && !existing.exact) {
+            existing.ambiguous = true;
+        }
+
+        return;
+    }
+
+    keys.push_back({vendorId, firmware, index, exact, false});
+}
+
+uint64_t firmware_table::hash(unsigned short vendorId, std::string_view firmware, uint32_t seed) {
+    // FNV-1a with the seed folded into the offset basis
+    uint64_t value = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    value = (value ^ (vendorId & 0xff)) * 0x100000001b3ULL;
+    value = (value ^ (vendorId >> 8)) * 0x100000001b3ULL;
+    for (unsigned char character : firmware) {
+        value = (value ^ character) * 0x100000001b3ULL;
+    }
+
+    // FNV leaves the low bits poorly mixed for short keys and those are the ones we mask with
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+
+    return value;
+}
+
+void firmware_table::build() {
+    std::vector<long> usable;
+    for (long i = 0; i < (long)keys.size(); ++i) {
+        if (!keys[i].ambiguous) {
+            usable.push_back(i);
+        }
+    }
+
+    size_t bucketCount = 1;
+    while (bucketCount * 2 < usable.size()) {
+        bucketCount <<= 1;
+    }
+
+    // Keep the table at most half full so every bucket finds a seed within a few tries
+    size_t slotCount = 1;
+    while (slotCount < usable.size() * 2) {
+        slotCount <<= 1;
+    }
+
+    bucketMask = bucketCount - 1;
+
+    std::vector<std::vector<long>> buckets(bucketCount);
+    for (auto key : usable) {
+        buckets[(hash(keys[key].vendorId, keys[key].firmware, 0) >> 32) & bucketMask].push_back(key);
+    }
+
+    // Place the crowded buckets first while there is still plenty of room
+    std::vector<size_t> order(bucketCount);
+    for (size_t i = 0; i < bucketCount; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    bool placed = false;
+    while (!placed) {
+        slotMask = slotCount - 1;
+        seeds.assign(bucketCount, 0);
+        slots.assign(slotCount, -1);
+        placed = true;
+
+        for (auto bucket : order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+
+            bool bucketPlaced = false;
+            std::vector<size_t> taken;
+            for (uint32_t seed = 1; seed < 65536 && !bucketPlaced; ++seed) {
+                taken.clear();
+                bucketPlaced = true;
+                for (auto key : buckets[bucket]) {
+                    size_t slot = hash(keys[key].vendorId, keys[key].firmware, seed) & slotMask;
+                    if (slots[slot] != -1 || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                        bucketPlaced = false;
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+
+                if (bucketPlaced) {
+                    seeds[bucket] = seed;
+                    for (size_t i = 0; i < taken.size(); ++i) {
+                        slots[taken[i]] = buckets[bucket][i];
+                    }
+                }
+            }
+
+            if (!bucketPlaced) {
+                // Start over with a sparser table
+                placed = false;
+                slotCount <<= 1;
+                break;
+            }
+        }
+    }
+}
+
+long firmware_table::probe(unsigned short vendorId, std::string_view firmware) const {
+    if (slots.empty()) {
+        return -1;
+    }
+
+    uint32_t seed = seeds[(hash(vendorId, firmware, 0) >> 32) & bucketMask];
+    long key = slots[hash(vendorId, firmware, seed) & slotMask];
+    if (key == -1 || keys[key].vendorId != vendorId || keys[key].firmware != firmware) {
+        return -1;
+    }
+
+    return keys[key].index;
+}
+
+long firmware_table::find(unsigned short vendorId, std::string_view firmware) const {
+    long index = probe(vendorId, firmware);
+    if (index != -1) {
+        return index;
+    }
+
+    auto prefix = modelPrefix(firmware);
+    if (prefix.size() == firmware.size()) {
+        return -1;
+    }
+
+    return probe(vendorId, prefix);
+}
+
+size_t firmware_table::size() const {
+    return keys.size();
+}
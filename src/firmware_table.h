@@ -0,0 +1,70 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_FIRMWARE_TABLE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_FIRMWARE_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Perfect hash from (vendor, firmware string) to a device database index. It is generated once from the database
+// using hash and displace: keys are grouped into buckets by one hash and every bucket gets a seed that scatters its
+// keys into free slots. A lookup is then two hashes and a single string compare with no allocation.
+//
+// Firmware strings look like HUION_T200_210315 where the last part is the build date. Besides the exact strings we
+// also index the part before the date so a new build of a known model resolves without a database update.
+class firmware_table {
+public:
+    firmware_table();
+
+    // Returns false if a key is already in the table for another index
+    bool add(unsigned short vendorId, const std::string& firmware, size_t index);
+    void build();
+
+    // Tries the exact firmware and then its model prefix. Returns -1 if neither is known
+    long find(unsigned short vendorId, std::string_view firmware) const;
+    size_t size() const;
+
+    static std::string_view modelPrefix(std::string_view firmware);
+private:
+    struct key {
+        unsigned short vendorId;
+        std::string firmware;
+        size_t index;
+        // Listed in the database rather than derived from another firmware string
+        bool exact;
+        // Prefixes shared by more than one device can't identify anything on their own
+        bool ambiguous;
+    };
+
+    void insert(unsigned short vendorId, const std::string& firmware, size_t index, bool exact);
+    long probe(unsigned short vendorId, std::string_view firmware) const;
+    static uint64_t hash(unsigned short vendorId, std::string_view firmware, uint32_t seed);
+
+    std::vector<key> keys;
+    std::vector<uint32_t> seeds;
+    // Index into keys, or -1 for an empty slot
+    std::vector<long> slots;
+    uint64_t slotMask;
+    uint64_t bucketMask;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_FIRMWARE_TABLE_H
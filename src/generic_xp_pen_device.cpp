@@ -18,14 +18,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "generic_xp_pen_device.h"
 
+static constexpr report_layout genericXpPenLayout = xpPenReportLayout.withButtons(2, 3).withWheel(7, 0x01, 0x02).withHorizontalWheel(0x10, 0x20);
+
 generic_xp_pen_device::generic_xp_pen_device(int productId) {
     // Create a device specification for generic XP-Pen devices
     device_specification spec;
     spec.numButtons = 20;  // High number to accommodate all possible buttons
     spec.hasDial = true;
     spec.hasHorizontalDial = true;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = genericXpPenLayout;
     
     // Register product IDs and names
     spec.addProduct(productId, "Generic XP-Pen Device");
@@ -46,68 +47,17 @@ generic_xp_pen_device::generic_xp_pen_device(int productId) {
     applyDefaultConfig(true);
 }
 
-bool generic_xp_pen_device::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
+generic_xp_pen_device::generic_xp_pen_device(const device_specification& spec)
+: xp_pen_unified_device(spec) {
+    applyDefaultConfig(spec.hasDial);
 }
 
-void generic_xp_pen_device::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        // Extract the button being pressed (If there is one)
-        long button = (data[4] << 16) + (data[3] << 8) + data[2];
-        // Grab the first bit set in the button long which tells us the button number
-        long position = ffsl(button);
-
-        std::bitset<8> dialBits(data[7]);
-
-        // Take the left dial
-        short leftDialValue = 0;
-        if (dialBits.test(0)) {
-            leftDialValue = 1;
-        } else if (dialBits.test(1)) {
-            leftDialValue = -1;
-        }
-
-        // Take the right dial
-        short rightDialValue = 0;
-        if (0x10 & data[7]) {
-            rightDialValue = 1;
-        } else if (0x20 & data[7]) {
-            rightDialValue = -1;
-        }
-
-        bool shouldSyn = true;
-        bool dialEvent = false;
-
-        if (leftDialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, leftDialValue);
-            shouldSyn = false;
-            dialEvent = true;
-        }
-
-        if (rightDialValue != 0) {
-            handleDialEvent(handle, REL_HWHEEL, rightDialValue);
-            shouldSyn = false;
-            dialEvent = true;
-        }
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else if (!dialEvent) {
-            handlePadButtonUnpressed(handle);
-        }
-
-        if (shouldSyn) {
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-        }
+bool generic_xp_pen_device::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    // The layout may come from the device database so it can only be read at runtime. The database only checks it
+    // against the largest packet it allows, so reports that are too short for it are dropped here
+    if (dataLen < (size_t)deviceSpec.layout.minReportLength()) {
+        return false;
     }
+
+    return decodeReport(deviceSpec.layout, context, data, dataLen);
 }
@@ -17,30 +17,50 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <iostream>
-#include <thread>
+#include <algorithm>
 #include "huion_handler.h"
 #include "device_interface_pair.h"
 #include "huion_tablet.h"
 
-huion_handler::huion_handler() {
-    std::cout << "huion_handler initialized" << std::endl;
-
-    // Physical product ids
-    addHandler(new huion_tablet(0x006e));
-    addHandler(new huion_tablet(0x006d));
+// What devices.json lists for Huion so firmware aliases still resolve when the database is missing
+static const char* builtinDevices = R"json({
+  "devices": [
+    { "vendor": "0x256c", "product": "0x006e", "name": "Huion tablet", "driver": "huion_tablet" },
+    { "vendor": "0x256c", "product": "0x006d", "name": "Huion tablet", "driver": "huion_tablet" },
+    { "vendor": "0x256c", "product": "0x0188", "name": "Huion WH1409 v2", "driver": "huion_tablet", "firmware": ["HUION_T188_180718"] },
+    { "vendor": "0x256c", "product": "0x0191", "name": "Huion H1161", "driver": "huion_tablet", "firmware": ["HUION_T191_190619"] },
+    { "vendor": "0x256c", "product": "0x0153", "name": "Huion WH1409 (2048)", "driver": "huion_tablet", "firmware": ["HUION_T153_160524"] },
+    { "vendor": "0x256c", "product": "0x0200", "name": "Huion KD100 mini Keydial", "driver": "huion_tablet", "firmware": ["HUION_T200_210309", "HUION_T200_210315", "HUION_T200_210430"] },
+    { "vendor": "0x256c", "product": "0x0182", "name": "Huion Kamvas Pro 13", "driver": "huion_tablet", "firmware": ["HUION_M182_200605"] },
+    { "vendor": "0x256c", "product": "0x0311", "name": "Gaomon M10K Pro", "driver": "huion_tablet", "firmware": ["OEM02_T19n_200311"] },
+    { "vendor": "0x256c", "product": "0x0119", "name": "Gaomon M10K 2018", "driver": "huion_tablet", "firmware": ["OEM02_T17b_190119"] }
+  ]
+})json";
+
+static const device_database& getBuiltinDatabase() {
+    // The tablets keep a pointer to this for as long as they live so it is never copied or destroyed early
+    static device_database database;
+    static bool loaded = database.load(nlohmann::json::parse(builtinDevices), "the built in Huion device list");
+    (void)loaded;
+
+    return database;
+}
 
-    // Aliased product ids
+huion_handler::huion_handler(const device_database& database) {
+    std::cout << "huion_handler initialized" << std::endl;
 
-    // HUION Tablets
-    addHandler(new huion_tablet(0x0188));
-    addHandler(new huion_tablet(0x0191));
-    addHandler(new huion_tablet(0x0153));
-    addHandler(new huion_tablet(0x0200));
-    addHandler(new huion_tablet(0x0182));
+    // Physical product ids are listed alongside the aliased ones that are resolved from the firmware
+    const device_database* devices = &database;
+    auto entries = devices->getVendorEntries(getVendorId());
+    if (entries.empty()) {
+        std::cout << "No Huion devices in the device database, using the built in product list" << std::endl;
+        devices = &getBuiltinDatabase();
+        entries = devices->getVendorEntries(getVendorId());
+    }
 
-    // GAOMON Tablets
-    addHandler(new huion_tablet(0x0311));
-    addHandler(new huion_tablet(0x0119));
+    for (auto entry : entries) {
+        addHandler(new huion_tablet(entry->productId, *devices));
+    }
 }
 
 int huion_handler::getVendorId() {
@@ -93,31 +113,9 @@ std::set<short> huion_handler::getConnectedDevices() {
 }
 
 bool huion_handler::handleProductAttach(libusb_device* device, const libusb_device_descriptor descriptor) {
-    libusb_device_handle* handle = NULL;
-    device_interface_pair* interfacePair = nullptr;
-    const int maxRetries = 5;
-    int currentAttept = 0;
-
-    if (std::find(handledProducts.begin(), handledProducts.end(), descriptor.idProduct) != handledProducts.end()) {
+    if (productHandlers.find(descriptor.idProduct) != productHandlers.end()) {
         std::cout << "Handling " << productHandlers[descriptor.idProduct]->getProductName(descriptor.idProduct) << std::endl;
-        while (interfacePair == nullptr  && currentAttept < maxRetries) {
-            interfacePair = claimDevice(device, handle, descriptor);
-            if (interfacePair == nullptr) {
-                std::cout << "Could not claim device on attempt " << currentAttept << ". Detaching and then waiting" << std::endl;
-                handleProductDetach(device, descriptor);
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                ++currentAttept;
-            }
-        }
-
-        if (interfacePair != nullptr) {
-            deviceInterfaces.push_back(interfacePair);
-            deviceInterfaceMap[device] = interfacePair;
-            return true;
-        }
-
-        std::cout << "Giving up" << std::endl;
-        return false;
+        return beginAttach(device, descriptor);
     }
 
     std::cout << "Unknown product " << descriptor.idProduct << std::endl;
@@ -126,12 +124,18 @@ bool huion_handler::handleProductAttach(libusb_device* device, const libusb_devi
 }
 
 void huion_handler::handleProductDetach(libusb_device *device, struct libusb_device_descriptor descriptor) {
+    cancelAttach(device);
+
     for (auto deviceObj : deviceInterfaceMap) {
         if (deviceObj.first == device) {
             std::cout << "Handling device detach" << std::endl;
 
-            if (productHandlers.find(descriptor.idProduct) != productHandlers.end()) {
-                productHandlers[descriptor.idProduct]->detachDevice(deviceObj.second->deviceHandle);
+            // The transfers have to come back from libusb before their handle is closed
+            releaseTransfers(deviceObj.second->deviceHandle);
+
+            // The device was attached to the handler of its (possibly aliased) product id
+            if (productHandlers.find(deviceObj.second->productId) != productHandlers.end()) {
+                productHandlers[deviceObj.second->productId]->detachDevice(deviceObj.second->deviceHandle);
             }
 
             cleanupDevice(deviceObj.second);
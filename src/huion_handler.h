@@ -21,10 +21,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include "vendor_handler.h"
+#include "device_database.h"
 
 class huion_handler : public vendor_handler {
 public:
-    huion_handler();
+    huion_handler(const device_database& database);
 
     int getVendorId();
     std::vector<int> getProductIds();
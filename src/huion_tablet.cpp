@@ -18,10 +18,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include "huion_tablet.h"
 
-huion_tablet::huion_tablet(int productId) {
+huion_tablet::huion_tablet(int productId, const device_database& deviceDatabase) {
     productIds.push_back(productId);
+    database = &deviceDatabase;
 
     for (int currentAssignedButton = BTN_0; currentAssignedButton <= BTN_9; ++currentAssignedButton) {
         padButtonAliases.push_back(currentAssignedButton);
@@ -86,79 +88,31 @@ bool huion_tablet::attachToInterfaceId(int interfaceId) {
     return interfaceId == 0;
 }
 
-std::string huion_tablet::getDeviceNameFromFirmware(std::wstring firmwareName) {
-    // HUION tablets
-    if (firmwareName == L"HUION_T188_180718") {
-        return "Huion WH1409 v2";
-    } else if (firmwareName == L"HUION_T191_190619") {
-        return "Huion H1161";
-    } else if (firmwareName == L"HUION_T153_160524") {
-        return "Huion WH1409 (2048)";
-    } else if (firmwareName == L"HUION_T200_210309" ||
-               firmwareName == L"HUION_T200_210315" ||
-               firmwareName == L"HUION_T200_210430") {
-        return "Huion KD100 mini Keydial";
-    } else if (firmwareName == L"HUION_M182_200605") {
-        return "Huion Kamvas Pro 13";
+std::string huion_tablet::getDeviceNameFromFirmware(std::string_view firmwareName) {
+    auto entry = database->findFirmware(0x256c, firmwareName);
+    if (entry == nullptr) {
+        return "Unknown device";
     }
 
-    // GAOMON tablets
-    else if (firmwareName == L"OEM02_T19n_200311") {
-        return "Gaomon M10K Pro";
-    }
-    else if (firmwareName == L"OEM02_T17b_190119"){
-        return "Gaomon M10K 2018";
-    }
-
-    return "Unknown device";
+    return entry->name;
 }
 
-int huion_tablet::getAliasedDeviceIdFromFirmware(std::wstring firmwareName) {
-    // HUION tablets
-    if (firmwareName == L"HUION_T188_180718") {
-        return 0x0188;
-    } else if (firmwareName == L"HUION_T191_190619") {
-        return 0x0191;
-    } else if (firmwareName == L"HUION_T153_160524") {
-        return 0x0153;
-    } else if (firmwareName == L"HUION_T200_210309" ||
-               firmwareName == L"HUION_T200_210315" ||
-               firmwareName == L"HUION_T200_210430") {
-        return 0x0200;
-    } else if (firmwareName == L"HUION_M182_200605") {
-        return 0x0182;
+int huion_tablet::getAliasedDeviceIdFromFirmware(std::string_view firmwareName) {
+    auto entry = database->findFirmware(0x256c, firmwareName);
+    if (entry == nullptr) {
+        return 0x0000;
     }
 
-    // GAOMON tablets
-    else if (firmwareName == L"OEM02_T19n_200311") {
-        return 0x0311;
-    }
-    else if (firmwareName == L"OEM02_T17b_190119"){
-        return 0x0119;
-    }
-
-    return 0x0000;
+    return entry->productId;
 }
 
 std::string huion_tablet::getDeviceNameFromAliasedId(int aliasedId) {
-    switch (aliasedId) {
-        case 0x0188:
-            return "Huion WH1409 v2";
-        case 0x0191:
-            return "Huion H1161";
-        case 0x0153:
-            return "Huion WH1409 (2048)";
-        case 0x0200:
-            return "Huion KD100 mini Keydial";
-        case 0x0182:
-            return "Huion Kamvas Pro 13";
-        case 0x0311:
-            return "Gaomon M10K Pro";
-        case 0x0119:
-            return "Gaomon M10K 2018";
-        default:
-            return "Unknown Huion Device";
+    auto entry = database->findProduct(0x256c, aliasedId);
+    if (entry == nullptr) {
+        return "Unknown Huion Device";
     }
+
+    return entry->name;
 }
 
 int huion_tablet::getAliasedProductId(libusb_device_handle *handle, int originalId) {
@@ -181,48 +135,58 @@ std::set<int> huion_tablet::getConnectedAliasedDevices() {
     return connectedAliases;
 }
 
-std::wstring huion_tablet::getDeviceFirmwareName(libusb_device_handle *handle) {
-    auto *buffer = new unsigned char[200];
-    memset(buffer, 0, 200);
+const std::string& huion_tablet::getDeviceFirmwareName(libusb_device_handle *handle) {
+    device_context* context = getDeviceContext(handle);
+    if (context->firmwareRead) {
+        return context->firmwareName;
+    }
 
-    // Extract the firmware name
-    int descriptorLength = libusb_get_string_descriptor(handle, 0xc9, 0x0409, buffer, 130);
+    // Only try once per attach even if it fails, a device that didn't answer the first time won't answer the second
+    context->firmwareRead = true;
+
+    unsigned char buffer[130] = {0};
+
+    // Extract the firmware name. Unlike the parameter descriptor read in attachDevice this one doesn't change how the
+    // tablet reports so it can come from an earlier attach
+    int descriptorLength = getStringDescriptor(handle, 0xc9, buffer, sizeof(buffer));
     if (descriptorLength < 36) {
         std::cout << "Could not get firmware descriptor. Returned descriptor length was " << descriptorLength
                   << std::endl;
-        delete[] buffer;
-        return L"";
+        return context->firmwareName;
     }
 
     if (buffer[1] != 0x03) {
         std::cout << "Descriptor response wasn't a string" << std::endl;
     }
-    int dataLength = buffer[0];
-    auto *firmwareName = new wchar_t[dataLength];
-    wmemset(firmwareName, 0, dataLength);
-    for (int i = 0, j = 2; i < descriptorLength; ++i, j += 2) {
-        firmwareName[i] = (buffer[j + 1] << 8) + buffer[j];
-    }
 
-    std::wstring firmware((wchar_t *) firmwareName);
-    delete[] firmwareName;
-    delete [] buffer;
+    // The descriptor is UTF-16LE but firmware names are plain ASCII so it is narrowed as it is read
+    int dataLength = std::min((int)buffer[0], descriptorLength);
+    for (int j = 2; j + 1 < dataLength; j += 2) {
+        int character = (buffer[j + 1] << 8) + buffer[j];
+        if (character == 0) {
+            break;
+        }
+
+        context->firmwareName.push_back(character < 0x80 ? (char)character : '?');
+    }
 
-    return firmware;
+    return context->firmwareName;
 }
 
 bool huion_tablet::attachDevice(libusb_device_handle *handle, int interfaceId, int productId) {
     std::vector<unsigned char> buffer(200, 0);
-    auto firmware = getDeviceFirmwareName(handle);
-    std::wcout << "Got firmware " << firmware << std::endl;
+    auto& firmware = getDeviceFirmwareName(handle);
+    std::cout << "Got firmware " << firmware << std::endl;
 
-    std::string deviceName = getDeviceNameFromFirmware(firmware);
+    auto entry = database->findFirmware(0x256c, firmware);
+    std::string deviceName = entry != nullptr ? entry->name : "Unknown device";
     std::cout << "Resolved device name to " << deviceName << std::endl;
     // Store the device name relationship to the handle
     handleToDeviceName[handle] = deviceName;
-    handleToAliasedDeviceId[handle] = getAliasedDeviceIdFromFirmware(firmware);
+    handleToAliasedDeviceId[handle] = entry != nullptr ? entry->productId : 0x0000;
 
-    // We need to get a few more bits of information
+    // We need to get a few more bits of information. Reading this is also what switches the tablet over to its own
+    // report format so it has to go to the device on every attach
     if (libusb_get_string_descriptor(handle, 200, 0x0409, &buffer[0], 32) < 18) {
         std::cout << "Could not get descriptor" << std::endl;
         // Let's see which descriptors are actually available
@@ -241,7 +205,7 @@ bool huion_tablet::attachDevice(libusb_device_handle *handle, int interfaceId, i
 
     int maxWidth = (buffer[4] << 16) + (buffer[3] << 8) + buffer[2];
     int maxHeight = (buffer[7] << 16) + (buffer[6] << 8) + buffer[5];
-    maxPressure = (buffer[9] << 8) + buffer[8];
+    setMaxPressure((buffer[9] << 8) + buffer[8]);
     int resolution = (buffer[11] << 8) + buffer[10];
 
     unsigned short vendorId = 0x256c;
@@ -267,9 +231,9 @@ bool huion_tablet::attachDevice(libusb_device_handle *handle, int interfaceId, i
         memset(penArgs.productName, 0, UINPUT_MAX_NAME_SIZE);
         memcpy(penArgs.productName, deviceName.c_str(), deviceName.length());
 
-        int pen_fd = create_pen(penArgs);
+        int pen_fd = create_pen(handle, penArgs);
         if (pen_fd < 0) return false;
-        uinputPens[handle] = pen_fd;
+        getDeviceContext(handle)->pen.fd = pen_fd;
     }
 
     struct uinput_pad_args padArgs{
@@ -291,15 +255,15 @@ bool huion_tablet::attachDevice(libusb_device_handle *handle, int interfaceId, i
     memset(padArgs.productName, 0, UINPUT_MAX_NAME_SIZE);
     memcpy(padArgs.productName, padNameString.c_str(), padNameString.length());
 
-    auto pad_fd = create_pad(padArgs);
+    auto pad_fd = create_pad(handle, padArgs);
     if (pad_fd < 0) return false;
-    uinputPads[handle] = pad_fd;
+    getDeviceContext(handle)->pad.fd = pad_fd;
 
 
     return true;
 }
 
-bool huion_tablet::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
+bool huion_tablet::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
 //    std::cout << std::dec << "Got transfer of data length: " << (int)dataLen << " data: ";
 //    for (int i = 0; i < dataLen; ++i) {
 //        std::cout << std::hex << std::setfill('0')  << std::setw(2) << (int)data[i] << ":";
@@ -308,8 +272,8 @@ bool huion_tablet::handleTransferData(libusb_device_handle *handle, unsigned cha
 
     switch (data[0]) {
         case 0x07:
-            handleDigitizerEventV3(handle, data, dataLen);
-            handlePadEventV1(handle, data, dataLen);
+            handleDigitizerEventV3(context, data, dataLen);
+            handlePadEventV1(context, data, dataLen);
             return true;
 
         case 0x08:
@@ -328,7 +292,7 @@ bool huion_tablet::handleTransferData(libusb_device_handle *handle, unsigned cha
         case 0x83:
         case 0x84:
         case 0x85:
-            handleDigitizerEventV2(handle, data, dataLen);
+            handleDigitizerEventV2(context, data, dataLen);
             break;
 
         case 0xc0:
@@ -337,21 +301,21 @@ bool huion_tablet::handleTransferData(libusb_device_handle *handle, unsigned cha
         case 0xc3:
         case 0xc4:
         case 0xc5:
-            handleDigitizerEventV1(handle, data, dataLen);
+            handleDigitizerEventV1(context, data, dataLen);
             break;
 
         case 0xe0:
-            handlePadEventV1(handle, data, dataLen);
+            handlePadEventV1(context, data, dataLen);
 
             break;
 
         case 0xf0:
-            handleTouchStripEvent(handle, data, dataLen);
+            handleTouchStripEvent(context, data, dataLen);
 
             break;
 
         case 0xf1:
-            handleTabletDialEvent(handle, data, dataLen);
+            handleTabletDialEvent(context, data, dataLen);
 
         default:
             return false;
@@ -360,7 +324,7 @@ bool huion_tablet::handleTransferData(libusb_device_handle *handle, unsigned cha
     return true;
 }
 
-void huion_tablet::handleDigitizerEventV1(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void huion_tablet::handleDigitizerEventV1(device_context* context, unsigned char *data, size_t dataLen) {
     int penX = (data[3] << 8) + data[2];
     int penY = (data[5] << 8) + data[4];
 
@@ -370,27 +334,27 @@ void huion_tablet::handleDigitizerEventV1(libusb_device_handle *handle, unsigned
     int pressure = (data[7] << 8) + data[6];
     if (stylusTipAndButton.test(0)) {
         // Grab the pressure amount
-        handlePenEnteredProximity(handle);
-        handlePenTouchingDigitizer(handle, pressure);
+        handlePenEnteredProximity(context);
+        handlePenTouchingDigitizer(context, pressure);
     } else {
-        handlePenTouchingDigitizer(handle, pressure);
+        handlePenTouchingDigitizer(context, pressure);
     }
 
     // Check to see if the stylus buttons are being pressed
     if (stylusTipAndButton.test(1)) {
-        handleStylusButtonsPressed(handle, BTN_STYLUS);
+        handleStylusButtonsPressed(context, BTN_STYLUS);
     } else if (stylusTipAndButton.test(2)) {
-        handleStylusButtonsPressed(handle, BTN_STYLUS2);
+        handleStylusButtonsPressed(context, BTN_STYLUS2);
     } else {
-        handleStylusButtonUnpressed(handle);
+        handleStylusButtonUnpressed(context);
     }
 
-    handleCoords(handle, penX, penY);
+    handleCoords(context, penX, penY);
 
-    uinput_send(uinputPens[handle], EV_SYN, SYN_REPORT, 1);
+    uinput_send(context->pen, EV_SYN, SYN_REPORT, 1);
 }
 
-void huion_tablet::handleDigitizerEventV2(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void huion_tablet::handleDigitizerEventV2(device_context* context, unsigned char *data, size_t dataLen) {
     // Extract the X and Y position
     int penX = (data[8] << 16) + (data[3] << 8) + data[2];
     int penY = (data[5] << 8) + data[4];
@@ -400,10 +364,10 @@ void huion_tablet::handleDigitizerEventV2(libusb_device_handle *handle, unsigned
     int pressure = (data[7] << 8) + data[6];
 
     if (stylusTipAndButton.test(0)) {
-        handlePenEnteredProximity(handle);
-        handlePenTouchingDigitizer(handle, pressure);
+        handlePenEnteredProximity(context);
+        handlePenTouchingDigitizer(context, pressure);
     } else {
-        handlePenTouchingDigitizer(handle, pressure);
+        handlePenTouchingDigitizer(context, pressure);
     }
 
     // Grab the tilt values
@@ -412,19 +376,19 @@ void huion_tablet::handleDigitizerEventV2(libusb_device_handle *handle, unsigned
 
     // Check to see if the stylus buttons are being pressed
     if (stylusTipAndButton.test(1)) {
-        handleStylusButtonsPressed(handle, BTN_STYLUS);
+        handleStylusButtonsPressed(context, BTN_STYLUS);
     } else if (stylusTipAndButton.test(2)) {
-        handleStylusButtonsPressed(handle, BTN_STYLUS2);
+        handleStylusButtonsPressed(context, BTN_STYLUS2);
     } else {
-        handleStylusButtonUnpressed(handle);
+        handleStylusButtonUnpressed(context);
     }
 
-    handleCoordsAndTilt(handle, penX, penY, tiltx, tilty);
+    handleCoordsAndTilt(context, penX, penY, tiltx, tilty);
 
-    uinput_send(uinputPens[handle], EV_SYN, SYN_REPORT, 1);
+    uinput_send(context->pen, EV_SYN, SYN_REPORT, 1);
 }
 
-void huion_tablet::handleDigitizerEventV3(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void huion_tablet::handleDigitizerEventV3(device_context* context, unsigned char *data, size_t dataLen) {
     if (data[1] < 0xa0) {
         // Extract the X and Y position
         int penX = (data[3] << 8) + data[2];
@@ -435,28 +399,28 @@ void huion_tablet::handleDigitizerEventV3(libusb_device_handle *handle, unsigned
         int pressure = (data[7] << 8) + data[6];
 
         if (stylusTipAndButton.test(0)) {
-            handlePenEnteredProximity(handle);
-            handlePenTouchingDigitizer(handle, pressure);
+            handlePenEnteredProximity(context);
+            handlePenTouchingDigitizer(context, pressure);
         } else {
-            handlePenTouchingDigitizer(handle, pressure);
+            handlePenTouchingDigitizer(context, pressure);
         }
 
         // Check to see if the stylus buttons are being pressed
         if (stylusTipAndButton.test(1)) {
-            handleStylusButtonsPressed(handle, BTN_STYLUS);
+            handleStylusButtonsPressed(context, BTN_STYLUS);
         } else if (0x04 & data[1]) {
-            handleStylusButtonsPressed(handle, BTN_STYLUS2);
+            handleStylusButtonsPressed(context, BTN_STYLUS2);
         } else {
-            handleStylusButtonUnpressed(handle);
+            handleStylusButtonUnpressed(context);
         }
 
-        handleCoords(handle, penX, penY);
+        handleCoords(context, penX, penY);
 
-        uinput_send(uinputPens[handle], EV_SYN, SYN_REPORT, 1);
+        uinput_send(context->pen, EV_SYN, SYN_REPORT, 1);
     }
 }
 
-void huion_tablet::handlePadEventV1(libusb_device_handle* handle, unsigned char* data, size_t dataLen) {
+void huion_tablet::handlePadEventV1(device_context* context, unsigned char* data, size_t dataLen) {
     if (data[1] == 0xe0) {
         // Extract the button being pressed (If there is one)
         long button = (data[6] << 16) +  (data[5] << 8) + data[4];
@@ -467,36 +431,36 @@ void huion_tablet::handlePadEventV1(libusb_device_handle* handle, unsigned char*
         bool dialEvent = false;
 
         if (button != 0) {
-            handlePadButtonPressed(handle, position);
+            handlePadButtonPressed(context, position);
         } else if (!dialEvent) {
-            handlePadButtonUnpressed(handle);
+            handlePadButtonUnpressed(context);
         }
 
         if (shouldSyn) {
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+            uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
         }
     }
 }
 
-void huion_tablet::handleTouchStripEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void huion_tablet::handleTouchStripEvent(device_context* context, unsigned char *data, size_t dataLen) {
     if (data[1] == 0xf0) {
         short touchValue = data[5];
         // Check if we let go
         if (touchValue == 0) {
-            touchStripLastValue = -1;
+            context->touchStripLastValue = -1;
             return;
         }
 
-        if (touchValue != touchStripLastValue) {
+        if (touchValue != context->touchStripLastValue) {
             int sendValue = 0;
-            if (touchStripLastValue == -1) {
-                touchStripLastValue = touchValue;
+            if (context->touchStripLastValue == -1) {
+                context->touchStripLastValue = touchValue;
                 return;
             }
 
-            if (touchValue < touchStripLastValue) {
+            if (touchValue < context->touchStripLastValue) {
                 sendValue = -1;
-            } else if (touchValue > touchStripLastValue) {
+            } else if (touchValue > context->touchStripLastValue) {
                 sendValue = 1;
             }
 
@@ -504,31 +468,31 @@ void huion_tablet::handleTouchStripEvent(libusb_device_handle *handle, unsigned
                 bool send_reset = false;
                 auto dialMap = dialMapping.getDialMap(EV_REL, REL_WHEEL, sendValue);
                 for (auto dmap : dialMap) {
-                    uinput_send(uinputPads[handle], dmap.event_type, dmap.event_value, dmap.event_data);
+                    uinput_send(context->pad, dmap.event_type, dmap.event_value, dmap.event_data);
                     if (dmap.event_type == EV_KEY) {
                         send_reset = true;
                     }
                 }
 
-                uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+                uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
 
                 if (send_reset) {
                     for (auto dmap : dialMap) {
                         // We have to handle key presses manually here because this device does not send reset events
                         if (dmap.event_type == EV_KEY) {
-                            uinput_send(uinputPads[handle], dmap.event_type, dmap.event_value, 0);
+                            uinput_send(context->pad, dmap.event_type, dmap.event_value, 0);
                         }
                     }
                 }
-                uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+                uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
             }
 
-            touchStripLastValue = touchValue;
+            context->touchStripLastValue = touchValue;
         }
     }
 }
 
-void huion_tablet::handleTabletDialEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void huion_tablet::handleTabletDialEvent(device_context* context, unsigned char *data, size_t dataLen) {
     if (data[1] == 0xf1) {
         short dialValue = 0;
         if (data[5] == 0x01) {
@@ -538,7 +502,7 @@ void huion_tablet::handleTabletDialEvent(libusb_device_handle *handle, unsigned
         }
 
         if (dialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, dialValue);
+            handleDialEvent(context, REL_WHEEL, dialValue);
         }
     }
 }
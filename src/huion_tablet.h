@@ -21,37 +21,41 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <set>
+#include <string_view>
 #include "transfer_handler.h"
+#include "device_database.h"
 
 class huion_tablet : public transfer_handler {
 public:
-    huion_tablet(int productId);
+    huion_tablet(int productId, const device_database& database);
 
     std::string getProductName(int productId);
     void setConfig(nlohmann::json config);
     int sendInitKeyOnInterface();
     bool attachToInterfaceId(int interfaceId);
     bool attachDevice(libusb_device_handle* handle, int interfaceId, int productId);
-    bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId);
+    bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId);
     std::set<int> getConnectedAliasedDevices();
-    std::wstring getDeviceFirmwareName(libusb_device_handle* device);
-    int getAliasedDeviceIdFromFirmware(std::wstring firmwareName);
+    // Read from the device the first time and served from its context afterwards
+    const std::string& getDeviceFirmwareName(libusb_device_handle* device);
+    int getAliasedDeviceIdFromFirmware(std::string_view firmwareName);
     int getAliasedProductId(libusb_device_handle* handle, int originalId);
     std::string getDeviceNameFromAliasedId(int aliasedId);
     std::string getInitKey() { return ""; }
 private:
-    void handleDigitizerEventV1(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
-    void handleDigitizerEventV2(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
-    void handleDigitizerEventV3(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
-    void handlePadEventV1(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
-    void handleTouchStripEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
-    void handleTabletDialEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
+    void handleDigitizerEventV1(device_context* context, unsigned char* data, size_t dataLen);
+    void handleDigitizerEventV2(device_context* context, unsigned char* data, size_t dataLen);
+    void handleDigitizerEventV3(device_context* context, unsigned char* data, size_t dataLen);
+    void handlePadEventV1(device_context* context, unsigned char* data, size_t dataLen);
+    void handleTouchStripEvent(device_context* context, unsigned char* data, size_t dataLen);
+    void handleTabletDialEvent(device_context* context, unsigned char* data, size_t dataLen);
 
-    std::string getDeviceNameFromFirmware(std::wstring firmwareName);
+    std::string getDeviceNameFromFirmware(std::string_view firmwareName);
+
+    const device_database* database;
 
     std::map<libusb_device_handle*, std::string> handleToDeviceName;
     std::map<libusb_device_handle*, int> handleToAliasedDeviceId;
-    short touchStripLastValue;
 };
 
 
@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include "innovator_16.h"
 
+static constexpr report_layout innovator16Layout = xpPenReportLayout.withButtons(2, 1).withWheel(7, 0x01, 0x02);
+
 innovator_16::innovator_16() {
     // Create a device specification for Innovator 16 devices
     device_specification spec;
     spec.numButtons = 8;
     spec.hasDial = true;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = innovator16Layout;
     
     // Register product IDs and names
     spec.addProduct(0x092c, "XP-Pen Innovator 16");
@@ -47,53 +48,6 @@ innovator_16::innovator_16() {
     applyDefaultConfig(true);
 }
 
-bool innovator_16::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
-    switch (data[0]) {
-        case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
-            handleFrameEvent(handle, data, dataLen);
-            break;
-
-        default:
-            break;
-    }
-
-    return true;
-}
-
-void innovator_16::handleFrameEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] >= 0xf0) {
-        long button = data[2];
-        // Only 8 buttons on this device
-        long position = ffsl(data[2]);
-
-        std::bitset<8> dialBits(data[7]);
-
-        // Take the dial
-        short dialValue = 0;
-        if (dialBits.test(0)) {
-            dialValue = 1;
-        } else if (dialBits.test(1)) {
-            dialValue = -1;
-        }
-
-        bool shouldSyn = true;
-        bool dialEvent = false;
-
-        if (dialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, dialValue);
-            shouldSyn = false;
-            dialEvent = true;
-        }
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else if (!dialEvent) {
-            handlePadButtonUnpressed(handle);
-        }
-
-        if (shouldSyn) {
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-        }
-    }
+bool innovator_16::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
+    return decodeReport<innovator16Layout>(context, data, dataLen);
 }
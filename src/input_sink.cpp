@@ -0,0 +1,52 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include "input_sink.h"
+#include "uinput_sink.h"
+#include "io_uring_sink.h"
+#include "memory_sink.h"
+
+input_sink* input_sink::create(const std::string& sinkName) {
+    if (sinkName == "memory") {
+        return new memory_sink();
+    }
+
+    if (sinkName == "io_uring") {
+        auto sink = new io_uring_sink();
+        if (sink->isValid()) {
+            return sink;
+        }
+
+        std::cout << "io_uring is not available, falling back to uinput writes" << std::endl;
+        delete sink;
+    } else if (sinkName != "uinput") {
+        std::cout << "Unknown input sink " << sinkName << ", using uinput" << std::endl;
+    }
+
+    return new uinput_sink();
+}
+
+void input_sink::recordLatency(latency_histogram& histogram, std::chrono::steady_clock::time_point receivedAt) {
+    histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - receivedAt).count());
+}
+
+input_sink* input_sink::getDefault() {
+    static uinput_sink defaultSink;
+    return &defaultSink;
+}
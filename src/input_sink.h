@@ -0,0 +1,58 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_INPUT_SINK_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_INPUT_SINK_H
+
+#include <linux/input.h>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include "latency_histogram.h"
+
+// Where the virtual input devices live and where their events go. Devices are still identified by an fd that the
+// uinput setup ioctls are issued against; a sink only decides how that fd is opened and how frames reach it.
+class input_sink {
+public:
+    virtual ~input_sink() {}
+
+    virtual std::string name() = 0;
+
+    // Returns an fd ready for the UI_SET_* and UI_DEV_* ioctls or -1 on failure
+    virtual int openDevice() = 0;
+    virtual void destroyDevice(int fd) = 0;
+    virtual void closeDevice(int fd) = 0;
+
+    // Writes one complete frame. The events can be reused by the caller as soon as this returns
+    virtual bool writeEvents(int fd, const struct input_event* events, size_t count) = 0;
+
+    // Pushes out anything the sink has been holding back. Called by the usb thread after each batch of transfers
+    virtual void submit() {}
+
+    // Closes the latency sample of a report once everything it wrote has reached the kernel. Sinks that write straight
+    // away record it here, sinks that hold frames back record it when they submit them
+    virtual void recordLatency(latency_histogram& histogram, std::chrono::steady_clock::time_point receivedAt);
+
+    // "uinput", "io_uring" or "memory". Unknown names and backends that can't start fall back to uinput
+    static input_sink* create(const std::string& sinkName);
+    // Used by handlers that were never handed a sink
+    static input_sink* getDefault();
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_INPUT_SINK_H
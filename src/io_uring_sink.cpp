@@ -0,0 +1,311 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "io_uring_sink.h"
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void* arg, unsigned args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, args);
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+io_uring_sink::io_uring_sink() {
+    ringFd = -1;
+    sqRing = MAP_FAILED;
+    sqRingSize = 0;
+    cqRing = MAP_FAILED;
+    cqRingSize = 0;
+    sqes = (struct io_uring_sqe*)MAP_FAILED;
+    sqesSize = 0;
+
+    freeSlotCount = 0;
+    for (unsigned int slot = ringEntries; slot > 0; --slot) {
+        freeSlots[freeSlotCount++] = slot - 1;
+    }
+
+    pendingSampleCount = 0;
+    pendingSubmissions = 0;
+    inFlight = 0;
+    failedWrites = 0;
+    writeSupported = false;
+
+    if (!setupRing()) {
+        std::cout << "Could not set up io_uring: " << strerror(errno) << std::endl;
+    } else if (!(writeSupported = supportsWrite())) {
+        std::cout << "io_uring does not support IORING_OP_WRITE on this kernel" << std::endl;
+    }
+}
+
+io_uring_sink::~io_uring_sink() {
+    if (ringFd >= 0) {
+        // Don't unmap buffers the kernel could still be reading from
+        drain();
+    }
+
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+
+    if (sqRing != MAP_FAILED) {
+        munmap(sqRing, sqRingSize);
+    }
+
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+}
+
+bool io_uring_sink::setupRing() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ringFd = io_uring_setup(ringEntries, &params);
+    if (ringFd < 0) {
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap && cqRingSize > sqRingSize) {
+        sqRingSize = cqRingSize;
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        return false;
+    }
+
+    if (singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            return false;
+        }
+    }
+
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+
+    auto sqBase = (char*)sqRing;
+    sqHead = (unsigned*)(sqBase + params.sq_off.head);
+    sqTail = (unsigned*)(sqBase + params.sq_off.tail);
+    sqMask = (unsigned*)(sqBase + params.sq_off.ring_mask);
+    sqArray = (unsigned*)(sqBase + params.sq_off.array);
+
+    auto cqBase = (char*)cqRing;
+    cqHead = (unsigned*)(cqBase + params.cq_off.head);
+    cqTail = (unsigned*)(cqBase + params.cq_off.tail);
+    cqMask = (unsigned*)(cqBase + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*)(cqBase + params.cq_off.cqes);
+
+    return true;
+}
+
+bool io_uring_sink::supportsWrite() {
+    // Kernels older than 5.6 have neither the probe nor IORING_OP_WRITE, so a failed probe means no support either way
+    const unsigned int probeOps = IORING_OP_WRITE + 1;
+    size_t probeSize = sizeof(struct io_uring_probe) + probeOps * sizeof(struct io_uring_probe_op);
+    auto probe = (struct io_uring_probe*)calloc(1, probeSize);
+    if (probe == nullptr) {
+        return false;
+    }
+
+    bool supported = false;
+    if (io_uring_register(ringFd, IORING_REGISTER_PROBE, probe, probeOps) == 0) {
+        supported = probe->last_op >= IORING_OP_WRITE && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    free(probe);
+    return supported;
+}
+
+bool io_uring_sink::isValid() const {
+    return ringFd >= 0 && sqes != MAP_FAILED && writeSupported;
+}
+
+std::string io_uring_sink::name() {
+    return "io_uring";
+}
+
+void io_uring_sink::destroyDevice(int fd) {
+    drain();
+    uinput_sink::destroyDevice(fd);
+}
+
+void io_uring_sink::closeDevice(int fd) {
+    drain();
+    uinput_sink::closeDevice(fd);
+}
+
+bool io_uring_sink::writeEvents(int fd, const struct input_event *events, size_t count) {
+    // Anything that doesn't go through the ring has to wait for the queued frames or it would overtake them
+    if (count > maxFrameEvents) {
+        if (!drain()) {
+            ++failedWrites;
+            return false;
+        }
+
+        return uinput_sink::writeEvents(fd, events, count);
+    }
+
+    unsigned tail = *sqTail;
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (freeSlotCount == 0 || tail - head > *sqMask) {
+        if (!drain()) {
+            ++failedWrites;
+            return false;
+        }
+
+        head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    unsigned int slot = freeSlots[--freeSlotCount];
+    memcpy(slots[slot].events, events, count * sizeof(struct input_event));
+
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)slots[slot].events;
+    sqe->len = count * sizeof(struct input_event);
+    sqe->off = (__u64)-1;
+    sqe->user_data = slot;
+
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++pendingSubmissions;
+
+    return true;
+}
+
+void io_uring_sink::submit() {
+    if (!isValid()) {
+        return;
+    }
+
+    if (pendingSubmissions > 0) {
+        // uinput writes complete inline, so everything queued here lands in the order it was written
+        int submitted = io_uring_enter(ringFd, pendingSubmissions, 0, 0);
+        if (submitted > 0) {
+            pendingSubmissions -= submitted;
+            inFlight += submitted;
+        }
+    }
+
+    if (pendingSubmissions == 0) {
+        closeLatencySamples();
+    }
+
+    reapCompletions();
+}
+
+void io_uring_sink::recordLatency(latency_histogram& histogram, std::chrono::steady_clock::time_point receivedAt) {
+    // Reports that didn't queue anything, or arrive when every sample slot is taken, are as done as they will get
+    if (pendingSubmissions == 0 || pendingSampleCount == ringEntries) {
+        input_sink::recordLatency(histogram, receivedAt);
+        return;
+    }
+
+    pendingSamples[pendingSampleCount++] = {&histogram, receivedAt};
+}
+
+void io_uring_sink::closeLatencySamples() {
+    if (pendingSampleCount == 0) {
+        return;
+    }
+
+    // uinput writes complete inside io_uring_enter so the frames are with the kernel by now
+    auto now = std::chrono::steady_clock::now();
+    for (unsigned int sample = 0; sample < pendingSampleCount; ++sample) {
+        pendingSamples[sample].histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - pendingSamples[sample].receivedAt).count());
+    }
+
+    pendingSampleCount = 0;
+}
+
+bool io_uring_sink::drain() {
+    while (pendingSubmissions > 0 || inFlight > 0) {
+        int submitted = io_uring_enter(ringFd, pendingSubmissions, inFlight > 0 ? 1 : 0, IORING_ENTER_GETEVENTS);
+        if (submitted < 0 && errno != EINTR) {
+            return false;
+        }
+
+        if (submitted > 0) {
+            pendingSubmissions -= submitted;
+            inFlight += submitted;
+        }
+
+        reapCompletions();
+    }
+
+    closeLatencySamples();
+    return true;
+}
+
+void io_uring_sink::reapCompletions() {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &cqes[head & *cqMask];
+        if (cqe->res < 0) {
+            ++failedWrites;
+        }
+
+        releaseSlot((unsigned int)cqe->user_data);
+        --inFlight;
+        ++head;
+    }
+
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+void io_uring_sink::releaseSlot(unsigned int slot) {
+    if (slot < ringEntries && freeSlotCount < ringEntries) {
+        freeSlots[freeSlotCount++] = slot;
+    }
+}
+
+unsigned long io_uring_sink::getFailedWrites() const {
+    return failedWrites;
+}
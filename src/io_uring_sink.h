@@ -0,0 +1,96 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_IO_URING_SINK_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_IO_URING_SINK_H
+
+#include <linux/io_uring.h>
+#include "uinput_sink.h"
+
+// uinput devices whose frames are queued as io_uring writes and handed to the kernel in one syscall per usb batch
+// instead of one write per frame. Device setup and teardown are the same as plain uinput.
+class io_uring_sink : public uinput_sink {
+public:
+    io_uring_sink();
+    ~io_uring_sink() override;
+
+    bool isValid() const;
+
+    std::string name() override;
+
+    // Both wait for every queued write so an fd is never torn down or reused under a pending write
+    void destroyDevice(int fd) override;
+    void closeDevice(int fd) override;
+
+    bool writeEvents(int fd, const struct input_event* events, size_t count) override;
+    void submit() override;
+    void recordLatency(latency_histogram& histogram, std::chrono::steady_clock::time_point receivedAt) override;
+
+    unsigned long getFailedWrites() const;
+
+private:
+    static const unsigned int ringEntries = 64;
+    static const size_t maxFrameEvents = 64;
+
+    struct frame_slot {
+        struct input_event events[maxFrameEvents];
+    };
+
+    // A report whose frames are still queued in the ring
+    struct latency_sample {
+        latency_histogram* histogram;
+        std::chrono::steady_clock::time_point receivedAt;
+    };
+
+    bool setupRing();
+    bool supportsWrite();
+    bool drain();
+    void reapCompletions();
+    void releaseSlot(unsigned int slot);
+    void closeLatencySamples();
+
+    int ringFd;
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+
+    frame_slot slots[ringEntries];
+    unsigned int freeSlots[ringEntries];
+    unsigned int freeSlotCount;
+    latency_sample pendingSamples[ringEntries];
+    unsigned int pendingSampleCount;
+    unsigned int pendingSubmissions;
+    unsigned int inFlight;
+    unsigned long failedWrites;
+    bool writeSupported;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_IO_URING_SINK_H
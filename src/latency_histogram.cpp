@@ -0,0 +1,105 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include "latency_histogram.h"
+
+latency_histogram::latency_histogram() {
+    reset();
+}
+
+void latency_histogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    count.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+int latency_histogram::bucketIndex(uint64_t value) {
+    if (value < subBucketCount) {
+        return (int)value;
+    }
+
+    const uint64_t maxValue = (1ULL << maxValueBits) - 1;
+    if (value > maxValue) {
+        value = maxValue;
+    }
+
+    // The position of the highest set bit picks the power of two range and the bits just below it the sub bucket
+    int highestBit = 63 - __builtin_clzll(value);
+    int shift = highestBit - subBucketBits;
+    int subBucket = (int)((value >> shift) & (subBucketCount - 1));
+
+    return subBucketCount + shift * subBucketCount + subBucket;
+}
+
+uint64_t latency_histogram::bucketUpperBound(int index) {
+    if (index < subBucketCount) {
+        return (uint64_t)index;
+    }
+
+    int shift = (index - subBucketCount) / subBucketCount;
+    int subBucket = (index - subBucketCount) % subBucketCount;
+    uint64_t lowerBound = (uint64_t)(subBucketCount + subBucket) << shift;
+
+    return lowerBound + (1ULL << shift) - 1;
+}
+
+void latency_histogram::record(uint64_t nanoseconds) {
+    buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    // Only the usb thread records so a plain compare is enough to keep the max
+    if (nanoseconds > max.load(std::memory_order_relaxed)) {
+        max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+uint64_t latency_histogram::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::getMax() const {
+    return max.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::getPercentile(double quantile) const {
+    uint64_t total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)std::ceil(quantile * total);
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int index = 0; index < bucketCount; ++index) {
+        seen += buckets[index].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t upperBound = bucketUpperBound(index);
+            uint64_t currentMax = getMax();
+            return upperBound < currentMax ? upperBound : currentMax;
+        }
+    }
+
+    return getMax();
+}
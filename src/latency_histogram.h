@@ -0,0 +1,67 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_LATENCY_HISTOGRAM_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+struct latency_summary {
+public:
+    short vendorId;
+    short productId;
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+// Log-linear histogram of nanosecond durations in the style of HdrHistogram. Every power of two range is split into
+// 16 sub buckets so any reported value is within ~6% of the real one. Recording is a couple of relaxed atomic adds
+// so the usb thread can record while the control thread reads.
+class latency_histogram {
+public:
+    latency_histogram();
+
+    void record(uint64_t nanoseconds);
+    void reset();
+
+    uint64_t getCount() const;
+    uint64_t getMax() const;
+    // Upper bound of the bucket holding the given quantile (0.0 - 1.0)
+    uint64_t getPercentile(double quantile) const;
+
+private:
+    static const int subBucketBits = 4;
+    static const int subBucketCount = 1 << subBucketBits;
+    // Anything above 2^40ns (~18 minutes) is clamped into the last bucket
+    static const int maxValueBits = 40;
+    static const int bucketCount = subBucketCount + (maxValueBits - subBucketBits) * subBucketCount;
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+    std::atomic<uint64_t> buckets[bucketCount];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> max;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_LATENCY_HISTOGRAM_H
@@ -0,0 +1,76 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "memory_sink.h"
+
+memory_sink::memory_sink() {
+    clear();
+}
+
+std::string memory_sink::name() {
+    return "memory";
+}
+
+int memory_sink::openDevice() {
+    return open("/dev/null", O_WRONLY | O_CLOEXEC);
+}
+
+void memory_sink::destroyDevice(int fd) {
+}
+
+void memory_sink::closeDevice(int fd) {
+    close(fd);
+}
+
+bool memory_sink::writeEvents(int fd, const struct input_event *events, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        recentEvents[(eventCount + i) % maxRecentEvents] = events[i];
+    }
+
+    eventCount += count;
+    ++frameCount;
+
+    return true;
+}
+
+unsigned long memory_sink::getFrameCount() const {
+    return frameCount;
+}
+
+unsigned long memory_sink::getEventCount() const {
+    return eventCount;
+}
+
+std::vector<struct input_event> memory_sink::getRecentEvents() const {
+    std::vector<struct input_event> events;
+    size_t kept = eventCount < maxRecentEvents ? eventCount : maxRecentEvents;
+    events.reserve(kept);
+
+    for (unsigned long index = eventCount - kept; index < eventCount; ++index) {
+        events.push_back(recentEvents[index % maxRecentEvents]);
+    }
+
+    return events;
+}
+
+void memory_sink::clear() {
+    frameCount = 0;
+    eventCount = 0;
+}
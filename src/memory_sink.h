@@ -0,0 +1,55 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_MEMORY_SINK_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_MEMORY_SINK_H
+
+#include <vector>
+#include "input_sink.h"
+
+// Keeps events in memory instead of handing them to the kernel. Meant for benchmarks, replays and tests. Devices
+// are backed by /dev/null so the setup ioctls fail harmlessly, and only the most recent events are kept so
+// recording never allocates.
+class memory_sink : public input_sink {
+public:
+    memory_sink();
+
+    std::string name() override;
+
+    int openDevice() override;
+    void destroyDevice(int fd) override;
+    void closeDevice(int fd) override;
+
+    bool writeEvents(int fd, const struct input_event* events, size_t count) override;
+
+    unsigned long getFrameCount() const;
+    unsigned long getEventCount() const;
+    // Oldest first, at most maxRecentEvents of them
+    std::vector<struct input_event> getRecentEvents() const;
+    void clear();
+
+private:
+    static const size_t maxRecentEvents = 4096;
+
+    struct input_event recentEvents[maxRecentEvents];
+    unsigned long frameCount;
+    unsigned long eventCount;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_MEMORY_SINK_H
@@ -0,0 +1,95 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "message_pool.h"
+
+message_pool::message_pool() {
+    // Sized once here so the addresses handed out never move
+    messages.resize(messageCount);
+    smallPayloads.resize(smallPayloadSize * smallPayloadCount);
+    largePayloads.resize(largePayloadSize * largePayloadCount);
+
+    for (auto& message : messages) {
+        freeMessages.push(&message);
+    }
+
+    for (size_t i = 0; i < smallPayloadCount; ++i) {
+        freeSmallPayloads.push(smallPayloads.data() + i * smallPayloadSize);
+    }
+
+    for (size_t i = 0; i < largePayloadCount; ++i) {
+        freeLargePayloads.push(largePayloads.data() + i * largePayloadSize);
+    }
+}
+
+unix_socket_message* message_pool::acquire(long dataLength) {
+    unix_socket_message* message = nullptr;
+    if (!freeMessages.pop(message)) {
+        message = new unix_socket_message();
+    }
+
+    *message = unix_socket_message();
+    message->length = dataLength;
+
+    // A payload that doesn't fit its own size class may still borrow a bigger buffer
+    message->data = nullptr;
+    if (dataLength > 0 && dataLength <= (long)smallPayloadSize) {
+        freeSmallPayloads.pop(message->data);
+    }
+
+    if (dataLength > 0 && message->data == nullptr && dataLength <= (long)largePayloadSize) {
+        freeLargePayloads.pop(message->data);
+    }
+
+    if (dataLength > 0 && message->data == nullptr) {
+        message->data = new unsigned char[dataLength];
+    }
+
+    return message;
+}
+
+void message_pool::release(unix_socket_message *message) {
+    if (message == nullptr) {
+        return;
+    }
+
+    if (message->data != nullptr) {
+        if (ownsPayload(smallPayloads, message->data)) {
+            freeSmallPayloads.push(message->data);
+        } else if (ownsPayload(largePayloads, message->data)) {
+            freeLargePayloads.push(message->data);
+        } else {
+            delete[] message->data;
+        }
+        message->data = nullptr;
+    }
+
+    if (ownsMessage(message)) {
+        freeMessages.push(message);
+    } else {
+        delete message;
+    }
+}
+
+bool message_pool::ownsMessage(const unix_socket_message *message) const {
+    return message >= messages.data() && message < messages.data() + messages.size();
+}
+
+bool message_pool::ownsPayload(const std::vector<unsigned char>& slab, const unsigned char *data) const {
+    return data >= slab.data() && data < slab.data() + slab.size();
+}
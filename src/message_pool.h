@@ -0,0 +1,57 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_MESSAGE_POOL_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_MESSAGE_POOL_H
+
+#include <vector>
+#include "unix_socket_message.h"
+#include "mpmc_queue.h"
+
+// Slabs of messages and payload buffers allocated once up front. Messages are created and released on both the
+// control and the usb thread so the free lists are lock-free queues. Anything the slabs can't hold, like a
+// payload bigger than the largest buffer or a burst that empties a free list, falls back to the heap.
+class message_pool {
+public:
+    message_pool();
+
+    // The payload is left uninitialised and data is nullptr for an empty one
+    unix_socket_message* acquire(long dataLength);
+    void release(unix_socket_message* message);
+
+private:
+    static const size_t messageCount = 256;
+    static const size_t smallPayloadSize = 64;
+    static const size_t smallPayloadCount = 256;
+    static const size_t largePayloadSize = 4096;
+    static const size_t largePayloadCount = 16;
+
+    bool ownsMessage(const unix_socket_message* message) const;
+    bool ownsPayload(const std::vector<unsigned char>& slab, const unsigned char* data) const;
+
+    std::vector<unix_socket_message> messages;
+    std::vector<unsigned char> smallPayloads;
+    std::vector<unsigned char> largePayloads;
+
+    mpmc_queue<unix_socket_message*, messageCount> freeMessages;
+    mpmc_queue<unsigned char*, smallPayloadCount> freeSmallPayloads;
+    mpmc_queue<unsigned char*, largePayloadCount> freeLargePayloads;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_MESSAGE_POOL_H
@@ -0,0 +1,99 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_MPMC_QUEUE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Bounded lock-free queue that any number of threads may push to and pop from. Every cell carries a sequence number
+// that says whether it is free for the producer at a position or holds the item for the consumer at it, so a
+// thread only ever has to win a compare and swap on the head or tail. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class mpmc_queue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "mpmc_queue capacity must be a power of two");
+
+public:
+    mpmc_queue() : head(0), tail(0) {
+        for (size_t i = 0; i < Capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false without touching the item if the queue is full
+    bool push(T item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            cell& target = cells[position & (Capacity - 1)];
+            intptr_t difference = (intptr_t)target.sequence.load(std::memory_order_acquire) - (intptr_t)position;
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    target.item = std::move(item);
+                    target.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if there was nothing to take
+    bool pop(T& item) {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true) {
+            cell& target = cells[position & (Capacity - 1)];
+            intptr_t difference = (intptr_t)target.sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+            if (difference == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    item = std::move(target.item);
+                    target.item = T();
+                    target.sequence.store(position + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only a hint while other threads are pushing or popping
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    struct cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    // Kept on separate cache lines so producers and consumers don't keep stealing the line from each other
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) cell cells[Capacity];
+};
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_MPMC_QUEUE_H
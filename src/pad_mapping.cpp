@@ -19,25 +19,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <linux/input.h>
 #include "pad_mapping.h"
 
-pad_mapping::pad_mapping() {
+pad_mapping::pad_mapping() : eventPadMap(KEY_CNT) {
 
 }
 
-std::vector<aliased_input_event> pad_mapping::getPadMap(int eventCode) {
-    auto record = eventPadMap.find(eventCode);
-    if (record != eventPadMap.end()) {
-        return eventPadMap.at(eventCode);
+aliased_input_event_view pad_mapping::getPadMap(int eventCode) {
+    aliased_input_event_view view;
+    if (eventPadMap.find(eventCode, view)) {
+        return view;
     }
 
-    std::vector<aliased_input_event> temp;
-    aliased_input_event tempEvent {
+    fallbackEvent = aliased_input_event {
         EV_KEY, eventCode
     };
-    temp.push_back(tempEvent);
 
-    return temp;
+    return aliased_input_event_view { &fallbackEvent, 1 };
 }
 
 void pad_mapping::setPadMap(int eventCode, const std::vector<aliased_input_event> &events) {
-    eventPadMap[eventCode] = events;
+    eventPadMap.set(eventCode, events);
 }
@@ -21,17 +21,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <vector>
-#include <map>
 #include "aliased_input_event.h"
+#include "aliased_input_event_table.h"
 
 class pad_mapping {
 public:
     pad_mapping();
 
-    std::vector<aliased_input_event> getPadMap(int eventCode);
+    aliased_input_event_view getPadMap(int eventCode);
     void setPadMap(int eventCode, const std::vector<aliased_input_event>& events);
 private:
-    std::map<int, std::vector<aliased_input_event> > eventPadMap;
+    // Indexed by the pad button code
+    aliased_input_event_table eventPadMap;
+    // Unmapped buttons are passed through as themselves
+    aliased_input_event fallbackEvent;
 };
 
 
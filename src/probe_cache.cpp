@@ -0,0 +1,83 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include "probe_cache.h"
+
+int probe_record::getStringDescriptor(libusb_device_handle *handle, uint8_t index, unsigned char *data, int length) {
+    uint32_t key = ((uint32_t)index << 16) | (uint16_t)length;
+    auto cached = stringDescriptors.find(key);
+    if (cached != stringDescriptors.end()) {
+        std::copy(cached->second.begin(), cached->second.end(), data);
+        return cached->second.size();
+    }
+
+    int descriptorLength = libusb_get_string_descriptor(handle, index, 0x0409, data, length);
+    if (descriptorLength > 0) {
+        stringDescriptors[key] = std::vector<unsigned char>(data, data + descriptorLength);
+    }
+
+    return descriptorLength;
+}
+
+probe_cache::probe_cache() {
+}
+
+std::string probe_cache::portPath(libusb_device *device) {
+    // USB 3 allows at most 7 tiers of hubs
+    uint8_t ports[7];
+    int portCount = libusb_get_port_numbers(device, ports, sizeof(ports));
+
+    std::string path = std::to_string(libusb_get_bus_number(device)) + "-";
+    for (int i = 0; i < portCount; ++i) {
+        if (i > 0) {
+            path += ".";
+        }
+        path += std::to_string(ports[i]);
+    }
+
+    return path;
+}
+
+probe_record* probe_cache::getRecord(libusb_device *device, const libusb_device_descriptor &descriptor) {
+    auto path = portPath(device);
+    auto record = records.find(path);
+    if (record != records.end()) {
+        probe_record& existing = record->second;
+        if (existing.vendorId == descriptor.idVendor && existing.productId == descriptor.idProduct &&
+            existing.bcdDevice == descriptor.bcdDevice) {
+            std::cout << "Reusing probe results for the device on port " << path << std::endl;
+            return &existing;
+        }
+
+        // Something else is on this port now, or the firmware was updated
+        existing = probe_record();
+    }
+
+    probe_record& created = records[path];
+    created.vendorId = descriptor.idVendor;
+    created.productId = descriptor.idProduct;
+    created.bcdDevice = descriptor.bcdDevice;
+
+    return &created;
+}
+
+size_t probe_cache::size() const {
+    return records.size();
+}
@@ -0,0 +1,67 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_PROBE_CACHE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_PROBE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <libusb-1.0/libusb.h>
+
+// What we learnt from probing a device the last time it was plugged into a port
+struct probe_record {
+public:
+    unsigned short vendorId = 0;
+    unsigned short productId = 0;
+    unsigned short bcdDevice = 0;
+
+    // Raw string descriptors keyed by index and requested length
+    std::unordered_map<uint32_t, std::vector<unsigned char>> stringDescriptors;
+
+    // Interfaces that stalled the HID set protocol and set idle requests. Those are safe to skip next time. Anything
+    // that succeeded has to be sent again since the device forgets it when it is unplugged.
+    std::unordered_set<unsigned char> reportProtocolUnsupported;
+    std::unordered_set<unsigned char> infiniteIdleUnsupported;
+
+    // Same contract as libusb_get_string_descriptor but only the first successful read goes to the device
+    int getStringDescriptor(libusb_device_handle* handle, uint8_t index, unsigned char* data, int length);
+};
+
+// Probe results of every device seen since startup keyed by the port it was plugged into. Tablets behind a KVM switch
+// come and go many times a day and this saves them from being probed from scratch each time. A record is dropped when
+// a different device, or the same device with a different bcdDevice, turns up on its port. Only touched from the usb
+// thread.
+class probe_cache {
+public:
+    probe_cache();
+
+    probe_record* getRecord(libusb_device* device, const libusb_device_descriptor& descriptor);
+    size_t size() const;
+
+    // Bus and port numbers down the hub chain, e.g. 1-2.4. Stays the same for as long as the device isn't moved
+    static std::string portPath(libusb_device* device);
+private:
+
+    std::unordered_map<std::string, probe_record> records;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_PROBE_CACHE_H
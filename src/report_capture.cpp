@@ -0,0 +1,119 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include "report_capture.h"
+
+const char report_capture::magic[6] = {'U', 'T', 'D', 'C', 'A', 'P'};
+
+report_capture::report_capture() {
+    file = nullptr;
+}
+
+report_capture::~report_capture() {
+    close();
+}
+
+bool report_capture::open(const std::string& capturePath) {
+    if (file != nullptr && capturePath == path) {
+        return true;
+    }
+
+    close();
+
+    file = fopen(capturePath.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Could not open capture file " << capturePath << " errno: " << errno << std::endl;
+        return false;
+    }
+
+    // Reports arrive a few hundred times a second so let stdio batch them into large writes
+    setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+
+    path = capturePath;
+    fwrite(magic, 1, sizeof(magic), file);
+    writeU16(formatVersion);
+
+    std::cout << "Capturing reports to " << path << std::endl;
+    return true;
+}
+
+void report_capture::close() {
+    if (file == nullptr) {
+        return;
+    }
+
+    fclose(file);
+    file = nullptr;
+    describedDevices.clear();
+    std::cout << "Stopped capturing reports to " << path << std::endl;
+    path.clear();
+}
+
+bool report_capture::isOpen() const {
+    return file != nullptr;
+}
+
+const std::string& report_capture::getPath() const {
+    return path;
+}
+
+void report_capture::writeReport(short vendorId, short productId, unsigned char endpoint, int maxPressure,
+                                 uint64_t timestamp, const unsigned char *data, size_t length) {
+    if (file == nullptr) {
+        return;
+    }
+
+    if (describedDevices.insert(std::make_pair(vendorId, productId)).second) {
+        writeU8(capture_record_type::captureDevice);
+        writeU16(vendorId);
+        writeU16(productId);
+        writeU32(maxPressure);
+    }
+
+    if (length > UINT16_MAX) {
+        length = UINT16_MAX;
+    }
+
+    writeU8(capture_record_type::captureReport);
+    writeU64(timestamp);
+    writeU16(vendorId);
+    writeU16(productId);
+    writeU8(endpoint);
+    writeU16(length);
+    fwrite(data, 1, length, file);
+}
+
+void report_capture::writeU8(uint8_t value) {
+    fputc(value, file);
+}
+
+void report_capture::writeU16(uint16_t value) {
+    unsigned char bytes[2] = {(unsigned char)value, (unsigned char)(value >> 8)};
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+void report_capture::writeU32(uint32_t value) {
+    writeU16(value);
+    writeU16(value >> 16);
+}
+
+void report_capture::writeU64(uint64_t value) {
+    writeU32(value);
+    writeU32(value >> 32);
+}
@@ -0,0 +1,67 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_REPORT_CAPTURE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_REPORT_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <utility>
+
+// Capture files are a small header followed by a stream of records, all little endian:
+//   header: "UTDCAP" u16 version
+//   device: u8 type(1) u16 vendor u16 product i32 maxPressure
+//   report: u8 type(2) u64 monotonic ns u16 vendor u16 product u8 endpoint u16 length payload
+// A device record is written before the first report of every device so a replay can set it up the same way.
+enum capture_record_type {
+    captureDevice = 1,
+    captureReport = 2
+};
+
+// Streams every raw report handed to a transfer handler into a capture file. Only ever used from the usb thread.
+class report_capture {
+public:
+    static const char magic[6];
+    static const uint16_t formatVersion = 1;
+
+    report_capture();
+    ~report_capture();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    const std::string& getPath() const;
+
+    void writeReport(short vendorId, short productId, unsigned char endpoint, int maxPressure, uint64_t timestamp,
+                     const unsigned char* data, size_t length);
+
+private:
+    void writeU8(uint8_t value);
+    void writeU16(uint16_t value);
+    void writeU32(uint32_t value);
+    void writeU64(uint64_t value);
+
+    FILE* file;
+    std::string path;
+    std::set<std::pair<short, short> > describedDevices;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_REPORT_CAPTURE_H
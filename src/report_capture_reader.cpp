@@ -0,0 +1,144 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <iostream>
+#include "report_capture_reader.h"
+
+report_capture_reader::report_capture_reader() {
+    file = nullptr;
+}
+
+report_capture_reader::~report_capture_reader() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+bool report_capture_reader::open(const std::string &path) {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cout << "Could not open capture file " << path << " errno: " << errno << std::endl;
+        return false;
+    }
+
+    char fileMagic[sizeof(report_capture::magic)];
+    uint16_t version;
+    if (fread(fileMagic, 1, sizeof(fileMagic), file) != sizeof(fileMagic) ||
+        memcmp(fileMagic, report_capture::magic, sizeof(fileMagic)) != 0 ||
+        !readU16(version)) {
+        std::cout << path << " is not a capture file" << std::endl;
+        return false;
+    }
+
+    if (version != report_capture::formatVersion) {
+        std::cout << "Unsupported capture version " << version << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool report_capture_reader::next(capture_record &record) {
+    uint8_t type;
+    uint16_t vendorId;
+    uint16_t productId;
+
+    if (file == nullptr || !readU8(type)) {
+        return false;
+    }
+
+    if (type == capture_record_type::captureDevice) {
+        uint32_t maxPressure;
+        if (!readU16(vendorId) || !readU16(productId) || !readU32(maxPressure)) {
+            return false;
+        }
+
+        record.type = capture_record_type::captureDevice;
+        record.vendorId = vendorId;
+        record.productId = productId;
+        record.maxPressure = maxPressure;
+        record.timestamp = 0;
+        record.endpoint = 0;
+        record.data.clear();
+        return true;
+    }
+
+    if (type == capture_record_type::captureReport) {
+        uint64_t timestamp;
+        uint8_t endpoint;
+        uint16_t length;
+        if (!readU64(timestamp) || !readU16(vendorId) || !readU16(productId) || !readU8(endpoint) || !readU16(length)) {
+            return false;
+        }
+
+        record.type = capture_record_type::captureReport;
+        record.vendorId = vendorId;
+        record.productId = productId;
+        record.maxPressure = 0;
+        record.timestamp = timestamp;
+        record.endpoint = endpoint;
+        record.data.resize(length);
+        return fread(record.data.data(), 1, length, file) == length;
+    }
+
+    std::cout << "Unknown capture record type " << (int)type << std::endl;
+    return false;
+}
+
+bool report_capture_reader::readU8(uint8_t &value) {
+    int byte = fgetc(file);
+    if (byte == EOF) {
+        return false;
+    }
+
+    value = byte;
+    return true;
+}
+
+bool report_capture_reader::readU16(uint16_t &value) {
+    unsigned char bytes[2];
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+        return false;
+    }
+
+    value = bytes[0] | (bytes[1] << 8);
+    return true;
+}
+
+bool report_capture_reader::readU32(uint32_t &value) {
+    uint16_t low;
+    uint16_t high;
+    if (!readU16(low) || !readU16(high)) {
+        return false;
+    }
+
+    value = low | ((uint32_t)high << 16);
+    return true;
+}
+
+bool report_capture_reader::readU64(uint64_t &value) {
+    uint32_t low;
+    uint32_t high;
+    if (!readU32(low) || !readU32(high)) {
+        return false;
+    }
+
+    value = low | ((uint64_t)high << 32);
+    return true;
+}
@@ -0,0 +1,61 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_REPORT_CAPTURE_READER_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_REPORT_CAPTURE_READER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "report_capture.h"
+
+struct capture_record {
+public:
+    capture_record_type type;
+    short vendorId;
+    short productId;
+    // Only set on device records
+    int maxPressure;
+    // Only set on report records
+    uint64_t timestamp;
+    unsigned char endpoint;
+    std::vector<unsigned char> data;
+};
+
+// Reads back the files written by report_capture
+class report_capture_reader {
+public:
+    report_capture_reader();
+    ~report_capture_reader();
+
+    bool open(const std::string& path);
+    // Returns false at the end of the file or on a truncated record
+    bool next(capture_record& record);
+
+private:
+    bool readU8(uint8_t& value);
+    bool readU16(uint16_t& value);
+    bool readU32(uint32_t& value);
+    bool readU64(uint64_t& value);
+
+    FILE* file;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_REPORT_CAPTURE_READER_H
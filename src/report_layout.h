@@ -0,0 +1,143 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_REPORT_LAYOUT_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_REPORT_LAYOUT_H
+
+#include <cstdint>
+
+// A little endian field of a report. A width of 0 means the report doesn't carry it
+struct report_field {
+    uint8_t offset;
+    uint8_t width;
+
+    constexpr bool present() const { return width > 0; }
+    constexpr int end() const { return present() ? offset + width : 0; }
+
+    constexpr int read(const unsigned char* data) const {
+        int value = 0;
+        for (int i = width - 1; i >= 0; --i) {
+            value = (value << 8) | data[offset + i];
+        }
+        return value;
+    }
+};
+
+// Where everything lives in the reports of an XP-Pen style device. Layouts are constexpr so that the decoder in
+// xp_pen_unified_device can be specialised per model at compile time and the field reads fold into constant offsets.
+struct report_layout {
+    uint8_t reportId;
+    // Values up to maxDigitizerStatus are pen reports and values from minFrameStatus are pad reports
+    report_field status;
+    uint8_t maxDigitizerStatus;
+    uint8_t minFrameStatus;
+
+    // Pen
+    report_field x;
+    report_field y;
+    // Bits 16-23 of X. Only sent by devices whose reports are exactly xHighReportLength long
+    report_field xHigh;
+    uint8_t xHighReportLength;
+    report_field pressure;
+    report_field tiltX;
+    report_field tiltY;
+
+    // Bits of the status byte
+    uint8_t tipBit;
+    uint8_t barrelBit;
+    uint8_t secondBarrelBit;
+    uint8_t eraserBit;
+    uint8_t outOfRangeBit;
+    uint8_t inRangeBit;
+    uint8_t leavingBit;
+
+    // Pad. Each set bit of the button bitmap is a button, the dial masks pick the bits of the dial byte
+    report_field buttons;
+    report_field dial;
+    uint8_t wheelUpMask;
+    uint8_t wheelDownMask;
+    uint8_t hWheelUpMask;
+    uint8_t hWheelDownMask;
+
+    constexpr bool hasFrame() const { return buttons.present() || dial.present(); }
+
+    // The shortest report every field can be read from. xHigh is left out as it is only read from reports that are
+    // exactly xHighReportLength long
+    constexpr int minReportLength() const {
+        const report_field fields[] = {status, x, y, pressure, tiltX, tiltY, buttons, dial};
+        int length = 1;
+        for (auto& field : fields) {
+            if (field.end() > length) {
+                length = field.end();
+            }
+        }
+        return length;
+    }
+
+    constexpr report_layout withButtons(uint8_t offset, uint8_t width) const {
+        report_layout layout = *this;
+        layout.buttons = {offset, width};
+        return layout;
+    }
+
+    constexpr report_layout withWheel(uint8_t offset, uint8_t upMask, uint8_t downMask) const {
+        report_layout layout = *this;
+        layout.dial = {offset, 1};
+        layout.wheelUpMask = upMask;
+        layout.wheelDownMask = downMask;
+        return layout;
+    }
+
+    constexpr report_layout withHorizontalWheel(uint8_t upMask, uint8_t downMask) const {
+        report_layout layout = *this;
+        layout.hWheelUpMask = upMask;
+        layout.hWheelDownMask = downMask;
+        return layout;
+    }
+};
+
+// The pen report shared by every XP-Pen device we know of. Models add their pad fields on top of this
+constexpr report_layout xpPenReportLayout = {
+        .reportId = 0x02,
+        .status = {1, 1},
+        .maxDigitizerStatus = 0xc0,
+        .minFrameStatus = 0xf0,
+        .x = {2, 2},
+        .y = {4, 2},
+        .xHigh = {10, 1},
+        .xHighReportLength = 12,
+        .pressure = {6, 2},
+        .tiltX = {8, 1},
+        .tiltY = {9, 1},
+        .tipBit = 0,
+        .barrelBit = 1,
+        .secondBarrelBit = 2,
+        .eraserBit = 3,
+        .outOfRangeBit = 4,
+        .inRangeBit = 5,
+        .leavingBit = 6,
+        .buttons = {0, 0},
+        .dial = {0, 0},
+        .wheelUpMask = 0,
+        .wheelDownMask = 0,
+        .hWheelUpMask = 0,
+        .hWheelDownMask = 0,
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_REPORT_LAYOUT_H
@@ -0,0 +1,44 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_SOCKET_CONNECTION_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_SOCKET_CONNECTION_H
+
+#include <cstddef>
+#include <vector>
+
+// A connected GUI client. Whatever a read returns is appended to the input buffer and every complete frame in it
+// is parsed in place, so a client may pipeline as many requests as fit before waiting for the responses.
+struct socket_connection {
+public:
+    int fd;
+    // Part of every request id from this connection. Responses are only written if it still matches, so a new
+    // connection that was given the same fd never gets the response to a request of the old one.
+    unsigned long serial;
+    unsigned long nextRequestId;
+
+    std::vector<unsigned char> input;
+    size_t inputLength;
+
+    // Whatever the socket wouldn't take straight away. Flushed from outputOffset once the socket is writable again.
+    std::vector<unsigned char> output;
+    size_t outputOffset;
+    bool waitingForWritable;
+};
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_SOCKET_CONNECTION_H
@@ -0,0 +1,168 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include "socket_frame.h"
+#include "socket_server.h"
+
+// Packed frame layout, every field little-endian:
+//   0  u32 magic            "UTD2"
+//   4  u16 version
+//   6  u16 header length    32 for this version, newer versions may append fields
+//   8  u32 payload length
+//  12  u32 request id
+//  16  u8  destination
+//  17  u8  flags            bit 0 asks for a response
+//  18  u16 vendor
+//  20  u16 device
+//  22  u16 interface
+//  24  u16 response interface
+//  26  u16 reserved
+//  28  u32 response length
+// A legacy header starts with its destination so it can never begin with the magic.
+const uint32_t socket_frame::packedMagic = 0x32445455;
+const uint16_t socket_frame::packedVersion = 1;
+
+static uint16_t readLe16(const unsigned char* data) {
+    return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+}
+
+static uint32_t readLe32(const unsigned char* data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void writeLe16(unsigned char* data, uint16_t value) {
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+}
+
+static void writeLe32(unsigned char* data, uint32_t value) {
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+    data[2] = (value >> 16) & 0xff;
+    data[3] = (value >> 24) & 0xff;
+}
+
+long socket_frame::parse(const unsigned char *data, size_t length, size_t maxPayloadLength, socket_frame_view &frame) {
+    if (length < sizeof(uint32_t)) {
+        return 0;
+    }
+
+    if (readLe32(data) == packedMagic) {
+        return parsePacked(data, length, maxPayloadLength, frame);
+    }
+
+    return parseLegacy(data, length, maxPayloadLength, frame);
+}
+
+long socket_frame::parseLegacy(const unsigned char *data, size_t length, size_t maxPayloadLength, socket_frame_view &frame) {
+    if (length < legacyHeaderSize) {
+        return 0;
+    }
+
+    unix_socket_message_header header;
+    memcpy(&header, data, legacyHeaderSize);
+
+    frame = socket_frame_view();
+    frame.format = socket_frame_format::legacyFrame;
+    if (header.signature != socket_server::versionSignature) {
+        // Nothing after a bad header can be trusted so only the header is skipped, as the old reader did
+        frame.valid = false;
+        return legacyHeaderSize;
+    }
+
+    if (header.length < 0 || (size_t)header.length > maxPayloadLength) {
+        return -1;
+    }
+
+    if (length < legacyHeaderSize + header.length) {
+        return 0;
+    }
+
+    frame.valid = true;
+    frame.destination = header.destination;
+    frame.expectResponse = header.expectResponse;
+    frame.vendor = header.vendor;
+    frame.device = header.device;
+    frame.interface = header.interface;
+    frame.responseInterface = header.responseInterface;
+    frame.responseLength = header.responseLength < 0 ? 0 : header.responseLength;
+    frame.requestId = 0;
+    frame.payload = data + legacyHeaderSize;
+    frame.payloadLength = header.length;
+
+    return legacyHeaderSize + header.length;
+}
+
+long socket_frame::parsePacked(const unsigned char *data, size_t length, size_t maxPayloadLength, socket_frame_view &frame) {
+    if (length < packedHeaderSize) {
+        return 0;
+    }
+
+    uint16_t version = readLe16(data + 4);
+    uint16_t headerLength = readLe16(data + 6);
+    uint32_t payloadLength = readLe32(data + 8);
+    if (version < packedVersion || headerLength < packedHeaderSize || payloadLength > maxPayloadLength) {
+        return -1;
+    }
+
+    if (length < (size_t)headerLength + payloadLength) {
+        return 0;
+    }
+
+    frame = socket_frame_view();
+    frame.format = socket_frame_format::packedFrame;
+    frame.valid = true;
+    frame.requestId = readLe32(data + 12);
+    frame.destination = (message_destination)data[16];
+    frame.expectResponse = (data[17] & 0x01) != 0;
+    frame.vendor = readLe16(data + 18);
+    frame.device = readLe16(data + 20);
+    frame.interface = readLe16(data + 22);
+    frame.responseInterface = readLe16(data + 24);
+    frame.responseLength = readLe32(data + 28);
+    frame.payload = data + headerLength;
+    frame.payloadLength = payloadLength;
+
+    return headerLength + payloadLength;
+}
+
+size_t socket_frame::encodeHeader(socket_frame_format format, const unix_socket_message *message, unsigned char *header) {
+    if (format == socket_frame_format::legacyFrame) {
+        // Old clients read back the front of the message exactly as it is laid out in memory
+        memcpy(header, message, legacyHeaderSize);
+        return legacyHeaderSize;
+    }
+
+    memset(header, 0, packedHeaderSize);
+    writeLe32(header, packedMagic);
+    writeLe16(header + 4, packedVersion);
+    writeLe16(header + 6, packedHeaderSize);
+    writeLe32(header + 8, message->length);
+    // The rest of our request id says which connection it came from, the client only knows the bottom half
+    writeLe32(header + 12, message->requestId & 0xffffffff);
+    header[16] = message->destination;
+    header[17] = message->expectResponse ? 0x01 : 0x00;
+    writeLe16(header + 18, message->vendor);
+    writeLe16(header + 20, message->device);
+    writeLe16(header + 22, message->interface);
+    writeLe16(header + 24, message->responseInterface);
+    writeLe32(header + 28, message->responseLength);
+
+    return packedHeaderSize;
+}
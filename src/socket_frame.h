@@ -0,0 +1,72 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_SOCKET_FRAME_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_SOCKET_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include "unix_socket_message.h"
+
+enum socket_frame_format {
+    // The in-memory unix_socket_message_header of the original clients, told apart by its signature
+    legacyFrame = 0,
+    // Fixed width little-endian fields, see socket_frame.cpp for the layout
+    packedFrame
+};
+
+// A frame parsed in place. The payload points into the buffer it was parsed from.
+struct socket_frame_view {
+    socket_frame_format format;
+    // Legacy frames with the wrong signature are skipped like they always were
+    bool valid;
+    message_destination destination;
+    bool expectResponse;
+    uint16_t vendor;
+    uint16_t device;
+    uint16_t interface;
+    uint16_t responseInterface;
+    uint32_t responseLength;
+    // Chosen by the client and echoed in the response. Legacy frames don't have one.
+    uint32_t requestId;
+    const unsigned char* payload;
+    uint32_t payloadLength;
+};
+
+class socket_frame {
+public:
+    static const uint32_t packedMagic;
+    static const uint16_t packedVersion;
+    static const size_t packedHeaderSize = 32;
+    static const size_t legacyHeaderSize = sizeof(unix_socket_message_header);
+    static const size_t maxHeaderSize = legacyHeaderSize > packedHeaderSize ? legacyHeaderSize : packedHeaderSize;
+
+    // Returns how many bytes the frame at the front of data takes up, 0 if it isn't complete yet or -1 if it is
+    // malformed or its payload is bigger than maxPayloadLength
+    static long parse(const unsigned char* data, size_t length, size_t maxPayloadLength, socket_frame_view& frame);
+
+    // Writes the header for a response in the given format and returns its size. The payload follows it unchanged.
+    static size_t encodeHeader(socket_frame_format format, const unix_socket_message* message, unsigned char* header);
+
+private:
+    static long parseLegacy(const unsigned char* data, size_t length, size_t maxPayloadLength, socket_frame_view& frame);
+    static long parsePacked(const unsigned char* data, size_t length, size_t maxPayloadLength, socket_frame_view& frame);
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_SOCKET_FRAME_H
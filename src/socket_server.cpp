@@ -28,6 +28,7 @@ namespace filesystem = std::filesystem;
 #endif
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <algorithm>
 #include <cstdlib>
@@ -35,8 +36,7 @@ namespace filesystem = std::filesystem;
 #include <unistd.h>
 #include <fcntl.h>
 #include <iostream>
-#include <iomanip>
-#include <poll.h>
+#include <sys/epoll.h>
 #include "socket_server.h"
 #include "unix_socket_message.h"
 
@@ -44,6 +44,10 @@ namespace filesystem = std::filesystem;
 long socket_server::versionSignature = 53784359345776669L;
 
 socket_server::socket_server() {
+    reactor = nullptr;
+    messageQueue = nullptr;
+    connectionSerial = 0;
+
     sock = socket(AF_UNIX, SOCK_STREAM, 0);
     enabled = sock != -1;
 
@@ -96,8 +100,8 @@ socket_server::socket_server() {
 }
 
 socket_server::~socket_server() {
-    for (auto socket : connectedSockets) {
-        close(socket);
+    for (auto& connection : connections) {
+        close(connection.first);
     }
 
     if (enabled) {
@@ -111,10 +115,33 @@ socket_server::~socket_server() {
     remove(socketLocation.str().c_str());
 }
 
+void socket_server::attachToReactor(event_reactor* eventReactor, unix_socket_message_queue* queue) {
+    reactor = eventReactor;
+    messageQueue = queue;
+
+    if (enabled) {
+        reactor->addFd(sock, EPOLLIN, [this](uint32_t events) {
+            handleConnections();
+        });
+    }
+
+    // Device responses are queued from the usb thread. Waking the loop is enough since it writes out every queued
+    // response on each turn
+    int responseFd = queue->getResponseFd();
+    if (responseFd != -1) {
+        reactor->addFd(responseFd, EPOLLIN, [responseFd](uint32_t events) {
+            uint64_t count;
+            while (read(responseFd, &count, sizeof(count)) == sizeof(count)) {
+            }
+        });
+    }
+}
+
 void socket_server::handleConnections() {
     if (enabled) {
         while (true) {
-            int newConnection = accept(sock, NULL, NULL);
+            // Non-blocking so that a client that stops reading can never stall the loop in a write
+            int newConnection = accept4(sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
             if (newConnection == -1) {
                 if (errno != EWOULDBLOCK && errno != EAGAIN) {
                     std::cout << "Error when accepting connection on socket" << std::endl;
@@ -124,129 +151,258 @@ void socket_server::handleConnections() {
             }
 
             std::cout << "Got new socket connection" << std::endl;
-            connectedSockets.push_back(newConnection);
+            socket_connection& connection = connections[newConnection];
+            connection.fd = newConnection;
+            connection.serial = ++connectionSerial;
+            connection.nextRequestId = 0;
+            connection.input.resize(inputBufferSize);
+            connection.inputLength = 0;
+            connection.outputOffset = 0;
+            connection.waitingForWritable = false;
+
+            if (reactor != nullptr) {
+                reactor->addFd(newConnection, EPOLLIN, [this, newConnection](uint32_t events) {
+                    handleSocketEvent(newConnection, events);
+                });
+            }
         }
     }
 }
 
-void socket_server::handleMessages(unix_socket_message_queue* messageQueue) {
-    int socketCount = connectedSockets.size();
-    if (socketCount > 0) {
-        struct pollfd *fds = static_cast<struct pollfd*>(calloc(socketCount, sizeof(struct pollfd)));
-        char headerBuffer[sizeof(unix_socket_message_header)];
+void socket_server::closeConnection(int fd) {
+    if (reactor != nullptr) {
+        reactor->removeFd(fd);
+    }
+
+    connections.erase(fd);
+    close(fd);
+}
+
+void socket_server::handleSocketEvent(int fd, uint32_t events) {
+    auto record = connections.find(fd);
+    if (record == connections.end() || !(events & (EPOLLIN | EPOLLOUT))) {
+        closeConnection(fd);
+        return;
+    }
 
-        for (int i = 0; i < socketCount; ++i) {
-            fds[i].fd = connectedSockets[i];
-            fds[i].events = POLLIN;
+    socket_connection& connection = record->second;
+    if (events & EPOLLOUT) {
+        if (!flushOutput(connection)) {
+            closeConnection(fd);
+            return;
         }
+    }
 
-        int res = poll(fds, socketCount, 0);
-        if (res > 0) {
-            for (int idx = 0; idx < socketCount; ++idx) {
-                if (fds[idx].revents != 0) {
-                    if (fds[idx].revents & POLLIN) {
-                        memset(headerBuffer, 0, sizeof(unix_socket_message_header));
-                        ssize_t s = read(fds[idx].fd, headerBuffer, sizeof(headerBuffer));
-                        if (s == sizeof(headerBuffer)) {
-                            // Validate the signature
-                            struct unix_socket_message *message = new unix_socket_message();
-                            memcpy(message, headerBuffer, sizeof(headerBuffer));
-
-                            if (message->signature == versionSignature) {
-                                bool failed = false;
-                                if (message->length > 0) {
-                                    message->data = new unsigned char[message->length];
-                                    ssize_t totalRead = 0;
-
-                                    while (totalRead < message->length) {
-                                        s = read(fds[idx].fd, message->data + totalRead, message->length - totalRead);
-
-                                        if (s == -1) {
-                                            // Handle something going wrong
-                                            delete[] message->data;
-                                            delete message;
-                                            failed = true;
-                                            break;
-                                        } else if (s == 0) {
-                                            // We reached the end but not all read
-                                            std::cout << "We only read a total of " << totalRead << " when we expected "
-                                                      << message->length << std::endl;
-                                            delete[] message->data;
-                                            delete message;
-                                            failed = true;
-                                            break;
-                                        }
-                                        totalRead += s;
-                                    }
-                                }
-
-                                if (!failed) {
-                                    message->originatingSocket = fds[idx].fd;
-                                    messageQueue->addMessage(message);
-                                }
-                            } else {
-                                std::cout << "Ignoring packet because we got a signature of " << message->signature << " when it should be " << versionSignature << std::endl;
-                            }
-                        } else {
-                            if (s == 0) {
-                                std::cout << "Connection closed on socket" << std::endl;
-                                auto record = std::find(connectedSockets.begin(), connectedSockets.end(), fds[idx].fd);
-                                if (record != connectedSockets.end()) {
-                                    connectedSockets.erase(record);
-                                }
-                                close(fds[idx].fd);
-                            } else {
-                                std::cout << "Could not get all header bytes. Expected " << sizeof(unix_socket_message_header) << " but only received " << s << std::endl;
-                                for (int i = 0; i < s; ++i) {
-                                    std::cout << std::hex << std::setfill('0')  << std::setw(2) << (int)headerBuffer[i] << ":";
-                                }
-                                std::cout << std::endl;
-                            }
-                        }
-                    } else {
-                        auto record = std::find(connectedSockets.begin(), connectedSockets.end(), fds[idx].fd);
-                        if (record != connectedSockets.end()) {
-                            connectedSockets.erase(record);
-                        }
-                        close(fds[idx].fd);
-                    }
-                }
-            }
+    if (!(events & EPOLLIN)) {
+        return;
+    }
+
+    if (connection.inputLength == connection.input.size()) {
+        std::cout << "Closing connection that sent a frame bigger than " << connection.input.size() << " bytes" << std::endl;
+        closeConnection(fd);
+        return;
+    }
+
+    // A single read picks up as many pipelined frames as the client has sent so far
+    ssize_t s = read(fd, connection.input.data() + connection.inputLength, connection.input.size() - connection.inputLength);
+    if (s == 0) {
+        std::cout << "Connection closed on socket" << std::endl;
+        closeConnection(fd);
+        return;
+    }
+
+    if (s == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cout << "Could not read from socket errno: " << errno << std::endl;
+            closeConnection(fd);
         }
+
+        // Otherwise a spurious wakeup, nothing to read yet
+        return;
+    }
+
+    connection.inputLength += s;
+    if (!parseFrames(connection)) {
+        closeConnection(fd);
     }
 }
 
-void socket_server::handleResponses(unix_socket_message_queue *messageQueue) {
-    auto responses = messageQueue->getResponses();
-    for (auto response : responses) {
-        ssize_t written = 0;
-        ssize_t s = 0;
-        bool failed = false;
-
-        while (written < sizeof(unix_socket_message_header)) {
-            s = write(response->originatingSocket, response + written, sizeof(unix_socket_message_header) - written);
-            if (s <= 0) {
-                failed = true;
-                std::cout << "Failed sending response header" << std::endl;
-                break;
-            }
+bool socket_server::parseFrames(socket_connection &connection) {
+    const size_t maxPayloadLength = connection.input.size() - socket_frame::maxHeaderSize;
+    size_t offset = 0;
+
+    while (offset < connection.inputLength) {
+        socket_frame_view frame;
+        long frameLength = socket_frame::parse(connection.input.data() + offset, connection.inputLength - offset,
+                                               maxPayloadLength, frame);
+        if (frameLength < 0) {
+            std::cout << "Closing connection that sent a malformed frame" << std::endl;
+            return false;
+        }
 
-            written += s;
+        if (frameLength == 0) {
+            break;
         }
 
-        written = 0;
-        while (!failed && written < response->length) {
-            s = write(response->originatingSocket, response->data + written, response->length - written);
+        if (frame.valid) {
+            queueFrame(connection, frame);
+        } else {
+            std::cout << "Ignoring packet because it has the wrong signature" << std::endl;
+        }
 
-            if (s <= 0) {
-                std::cout << "Failed sending the data of the response" << std::endl;
-                break;
+        offset += frameLength;
+    }
+
+    // Move the start of a partial frame to the front so the rest of it can be read in behind it
+    if (offset > 0) {
+        memmove(connection.input.data(), connection.input.data() + offset, connection.inputLength - offset);
+        connection.inputLength -= offset;
+    }
+
+    return true;
+}
+
+void socket_server::queueFrame(socket_connection &connection, const socket_frame_view &frame) {
+    // The payload is only copied once, straight from the input buffer into the pooled message that carries it
+    // to the usb thread
+    unix_socket_message* message = messageQueue->createMessage(frame.payloadLength);
+    message->destination = frame.destination;
+    message->vendor = frame.vendor;
+    message->device = frame.device;
+    message->interface = frame.interface;
+    message->expectResponse = frame.expectResponse;
+    message->responseLength = frame.responseLength;
+    message->responseInterface = frame.responseInterface;
+    message->originatingSocket = connection.fd;
+    message->signature = versionSignature;
+    if (frame.payloadLength > 0) {
+        memcpy(message->data, frame.payload, frame.payloadLength);
+    }
+
+    // Packed frames carry the client's own id so pipelined responses can be matched up. Legacy ones are numbered.
+    uint32_t clientRequestId = frame.format == socket_frame_format::packedFrame ? frame.requestId : connection.nextRequestId++;
+    message->requestId = makeRequestId(connection.serial, frame.format, clientRequestId);
+
+    messageQueue->addMessage(message);
+}
+
+unsigned long socket_server::makeRequestId(unsigned long serial, socket_frame_format format, uint32_t clientRequestId) {
+    unsigned long packedBit = format == socket_frame_format::packedFrame ? 1 : 0;
+    return (serial << 33) | (packedBit << 32) | clientRequestId;
+}
+
+unsigned long socket_server::requestSerial(unsigned long requestId) {
+    return requestId >> 33;
+}
+
+socket_frame_format socket_server::requestFormat(unsigned long requestId) {
+    return ((requestId >> 32) & 1) ? socket_frame_format::packedFrame : socket_frame_format::legacyFrame;
+}
+
+bool socket_server::sendFrame(socket_connection &connection, const unsigned char *header, size_t headerLength,
+                              const unsigned char *payload, size_t payloadLength) {
+    size_t sent = 0;
+
+    // Frames must not overtake what is already waiting, otherwise try to hand the whole frame over without copying
+    if (connection.outputOffset == connection.output.size()) {
+        struct iovec parts[2];
+        parts[0].iov_base = (void*)header;
+        parts[0].iov_len = headerLength;
+        parts[1].iov_base = (void*)payload;
+        parts[1].iov_len = payloadLength;
+
+        struct msghdr frameMessage {};
+        frameMessage.msg_iov = parts;
+        frameMessage.msg_iovlen = payloadLength > 0 ? 2 : 1;
+
+        ssize_t s = sendmsg(connection.fd, &frameMessage, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (s == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cout << "Failed sending response errno: " << errno << std::endl;
+            return false;
+        }
+
+        if (s > 0) {
+            sent = s;
+        }
+    }
+
+    size_t frameLength = headerLength + payloadLength;
+    if (sent == frameLength) {
+        return true;
+    }
+
+    size_t pending = connection.output.size() - connection.outputOffset;
+    if (pending + frameLength - sent > outputBudget) {
+        std::cout << "Disconnecting client that has " << pending << " bytes of responses it isn't reading" << std::endl;
+        return false;
+    }
+
+    // Only the part the socket didn't take is kept, resuming part way through the header or payload
+    if (sent < headerLength) {
+        connection.output.insert(connection.output.end(), header + sent, header + headerLength);
+        sent = headerLength;
+    }
+    connection.output.insert(connection.output.end(), payload + (sent - headerLength), payload + payloadLength);
+
+    watchWritable(connection, true);
+    return true;
+}
+
+bool socket_server::flushOutput(socket_connection &connection) {
+    while (connection.outputOffset < connection.output.size()) {
+        ssize_t s = send(connection.fd, connection.output.data() + connection.outputOffset,
+                         connection.output.size() - connection.outputOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (s == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Still full, EPOLLOUT tells us when to try again
+                return true;
             }
 
-            written += s;
+            std::cout << "Failed sending response errno: " << errno << std::endl;
+            return false;
         }
 
-        delete[] response->data;
-        delete response;
+        connection.outputOffset += s;
+    }
+
+    // Everything went out so the buffer starts over, keeping its capacity for next time
+    connection.output.clear();
+    connection.outputOffset = 0;
+    watchWritable(connection, false);
+
+    return true;
+}
+
+void socket_server::watchWritable(socket_connection &connection, bool watch) {
+    if (connection.waitingForWritable == watch || reactor == nullptr) {
+        return;
+    }
+
+    if (reactor->modifyFd(connection.fd, watch ? EPOLLIN | EPOLLOUT : EPOLLIN)) {
+        connection.waitingForWritable = watch;
+    }
+}
+
+void socket_server::handleResponses(unix_socket_message_queue *messageQueue) {
+    unsigned char header[socket_frame::maxHeaderSize];
+
+    messageQueue->getResponses(responses);
+    for (auto response : responses) {
+        // Responses can arrive long after their request now so the connection may have gone in the meantime
+        auto connection = connections.find(response->originatingSocket);
+        if (connection == connections.end() || connection->second.serial != requestSerial(response->requestId)) {
+            std::cout << "Dropping response to request " << response->requestId << " of a closed connection" << std::endl;
+            messageQueue->releaseMessage(response);
+            continue;
+        }
+
+        size_t headerLength = socket_frame::encodeHeader(requestFormat(response->requestId), response, header);
+        int fd = response->originatingSocket;
+        bool sent = sendFrame(connection->second, header, headerLength, response->data, response->length);
+
+        messageQueue->releaseMessage(response);
+        if (!sent) {
+            closeConnection(fd);
+        }
     }
 }
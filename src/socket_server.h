@@ -21,23 +21,56 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <vector>
+#include <map>
+#include <cstdint>
 #include "unix_socket_message_queue.h"
+#include "event_reactor.h"
+#include "socket_connection.h"
+#include "socket_frame.h"
 
 class socket_server {
 public:
     socket_server();
     ~socket_server();
 
+    void attachToReactor(event_reactor* eventReactor, unix_socket_message_queue* queue);
     void handleConnections();
-    void handleMessages(unix_socket_message_queue* messageQueue);
     void handleResponses(unix_socket_message_queue* messageQueue);
 
     static long versionSignature;
 private:
+    void handleSocketEvent(int fd, uint32_t events);
+    void closeConnection(int fd);
+    // Queues every complete frame in the input buffer and keeps whatever is left of a partial one
+    bool parseFrames(socket_connection& connection);
+    void queueFrame(socket_connection& connection, const socket_frame_view& frame);
+    // Both return false if the client has to be disconnected
+    bool sendFrame(socket_connection& connection, const unsigned char* header, size_t headerLength,
+                   const unsigned char* payload, size_t payloadLength);
+    bool flushOutput(socket_connection& connection);
+    void watchWritable(socket_connection& connection, bool watch);
+
+    // Request ids carry the connection serial above bit 32, whether the request came in a packed frame in bit 32 and
+    // the id the client knows it by in the bottom half. Responses copy the id so they go back in the same format.
+    static unsigned long makeRequestId(unsigned long serial, socket_frame_format format, uint32_t clientRequestId);
+    static unsigned long requestSerial(unsigned long requestId);
+    static socket_frame_format requestFormat(unsigned long requestId);
+
     int sock;
     bool enabled;
 
-    std::vector<int> connectedSockets;
+    static const size_t inputBufferSize = 65536;
+    // A client that lets this much pile up has stopped reading and is dropped rather than slowing down the loop
+    static const size_t outputBudget = 262144;
+
+    std::map<int, socket_connection> connections;
+    unsigned long connectionSerial;
+
+    // Reused on every turn of the loop
+    std::vector<unix_socket_message*> responses;
+
+    event_reactor* reactor;
+    unix_socket_message_queue* messageQueue;
 };
 
 
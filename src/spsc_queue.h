@@ -0,0 +1,75 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_SPSC_QUEUE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class spsc_queue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "spsc_queue capacity must be a power of two");
+
+public:
+    spsc_queue() : head(0), tail(0) {}
+
+    // Producer side. Returns false without touching the item if the queue is full.
+    bool push(T&& item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+
+        slots[currentTail & (Capacity - 1)] = std::move(item);
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(const T& item) {
+        T copy(item);
+        return push(std::move(copy));
+    }
+
+    // Consumer side. Returns false if there was nothing to take.
+    bool pop(T& item) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = std::move(slots[currentHead & (Capacity - 1)]);
+        slots[currentHead & (Capacity - 1)] = T();
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // Kept on separate cache lines so the producer and consumer don't keep stealing the line from each other
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) T slots[Capacity];
+};
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_SPSC_QUEUE_H
@@ -20,14 +20,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iomanip>
 #include "star.h"
 
+static constexpr report_layout starLayout = xpPenReportLayout;
+
 star::star() {
     // Initialize with default device specification
     device_specification spec;
     spec.numButtons = 0;  // Star devices focus on stylus buttons rather than pad buttons
     spec.hasDial = false;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    spec.layout = starLayout;
     
     // Initialize the base class with the specification
     deviceSpec = spec;
@@ -67,14 +68,11 @@ bool star::attachToInterfaceId(int interfaceId) {
     return true;
 }
 
-bool star::handleTransferData(libusb_device_handle *handle, unsigned char *data, size_t dataLen, int productId) {
+bool star::handleTransferData(device_context* context, unsigned char *data, size_t dataLen, int productId) {
     switch (data[0]) {
         case 0x07:
-            handleDigitizerEvent(handle, data, dataLen);
-            break;
-
         case 0x02:
-            handleDigitizerEvent(handle, data, dataLen);
+            decodeDigitizer<starLayout>(context, data, dataLen);
             break;
 
         default:
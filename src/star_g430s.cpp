@@ -26,8 +26,8 @@ star_g430s::star_g430s() {
     spec.numButtons = 0;  // Star devices focus on stylus buttons rather than pad buttons
     spec.hasDial = false;
     spec.hasHorizontalDial = false;
-    spec.buttonByteIndex = 2;
-    spec.dialByteIndex = 7;
+    // Decoded by star::handleTransferData
+    spec.layout = xpPenReportLayout;
     
     // Register product IDs and names
     spec.addProduct(0x0913, "XP-Pen Star G430S");
@@ -89,7 +89,7 @@ bool star_g430s::attachDevice(libusb_device_handle *handle, int interfaceId, int
     // Hard coding these values in because the probe returns physical values.
     int maxWidth = 0x7fff;
     int maxHeight = 0x7fff;
-    maxPressure = (buf[9] << 8) + buf[8];
+    setMaxPressure((buf[9] << 8) + buf[8]);
     int resolution = (buf[11] << 8) + buf[10];
 
     std::string deviceName = "Star G430S";
@@ -125,13 +125,13 @@ bool star_g430s::attachDevice(libusb_device_handle *handle, int interfaceId, int
                 {"XP-Pen Star G430S Pad"},
         };
 
-        auto pen_fd = create_pen(penArgs);
-        auto pad_fd = create_pad(padArgs);
+        auto pen_fd = create_pen(handle, penArgs);
+        auto pad_fd = create_pad(handle, padArgs);
         if (pen_fd < 0 || pad_fd < 0)
             return false;
 
-        uinputPens[handle] = pen_fd;
-        uinputPads[handle] = pad_fd;
+        getDeviceContext(handle)->pen.fd = pen_fd;
+        getDeviceContext(handle)->pad.fd = pad_fd;
     }
 
     return true;
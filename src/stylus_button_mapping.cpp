@@ -19,21 +19,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <linux/input.h>
 #include "stylus_button_mapping.h"
 
-stylus_button_mapping::stylus_button_mapping() {
+stylus_button_mapping::stylus_button_mapping() : eventStylusButtonMap(KEY_CNT) {
 
 }
 
-std::vector<aliased_input_event> stylus_button_mapping::getStylusButtonMap(int eventCode) {
-    auto record = eventStylusButtonMap.find(eventCode);
-    if (record != eventStylusButtonMap.end()) {
-        return eventStylusButtonMap.at(eventCode);
-    }
+aliased_input_event_view stylus_button_mapping::getStylusButtonMap(int eventCode) {
+    aliased_input_event_view view { nullptr, 0 };
+    eventStylusButtonMap.find(eventCode, view);
 
-    std::vector<aliased_input_event> temp;
-
-    return temp;
+    return view;
 }
 
 void stylus_button_mapping::setStylusButtonMap(int eventCode, const std::vector<aliased_input_event> &events) {
-    eventStylusButtonMap[eventCode] = events;
+    eventStylusButtonMap.set(eventCode, events);
 }
@@ -20,17 +20,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define USERSPACE_TABLET_DRIVER_DAEMON_STYLUS_BUTTON_MAPPING_H
 
 #include <vector>
-#include <map>
 #include "aliased_input_event.h"
+#include "aliased_input_event_table.h"
 
 class stylus_button_mapping {
 public:
     stylus_button_mapping();
 
-    std::vector<aliased_input_event> getStylusButtonMap(int eventCode);
+    aliased_input_event_view getStylusButtonMap(int eventCode);
     void setStylusButtonMap(int eventCode, const std::vector<aliased_input_event>& events);
 private:
-    std::map<int, std::vector<aliased_input_event> > eventStylusButtonMap;
+    // Indexed by the stylus button code
+    aliased_input_event_table eventStylusButtonMap;
 };
 
 
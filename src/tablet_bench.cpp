@@ -0,0 +1,312 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include "artist_24_pro.h"
+#include "artist_12_pro.h"
+#include "huion_tablet.h"
+#include "huion_handler.h"
+#include "xp_pen_handler.h"
+#include "report_capture_reader.h"
+#include "memory_sink.h"
+
+// Microbenchmarks for the report decode and dispatch path. Every device writes to a memory sink so the numbers cover
+// parsing, mapping lookups, state tracking and frame batching, but no syscalls and nothing in the kernel.
+
+// Every allocation in the process goes through these so we can report allocations per report. They are kept out of
+// line because once one is inlined the compiler sees malloc or free paired with new or delete and warns about it
+static unsigned long allocationCount = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++allocationCount;
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+// Exposes the protected pieces of a handler that we want to time in isolation
+class bench_artist_12_pro : public artist_12_pro {
+public:
+    using artist_12_pro::applyPressureCurve;
+    using artist_12_pro::padMapping;
+    using artist_12_pro::dialMapping;
+    using artist_12_pro::padButtonAliases;
+    using artist_12_pro::create_pad;
+};
+
+struct bench_result {
+public:
+    std::string name;
+    double nsPerReport;
+    double allocationsPerReport;
+};
+
+template <typename F>
+bench_result runBench(const std::string& name, unsigned long iterations, F body) {
+    // Warm the caches and let lazily built state settle before measuring
+    for (unsigned long i = 0; i < iterations / 10; ++i) {
+        body(i);
+    }
+
+    unsigned long allocationsBefore = allocationCount;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        body(i);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    return bench_result {
+        name,
+        (double)elapsed.count() / iterations,
+        (double)(allocationCount - allocationsBefore) / iterations
+    };
+}
+
+static void printResult(const bench_result& result) {
+    std::cout << std::left << std::setw(48) << result.name
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1) << result.nsPerReport << " ns/report"
+              << std::setw(10) << std::setprecision(3) << result.allocationsPerReport << " allocs/report" << std::endl;
+}
+
+// A pen report moving across the tablet with changing pressure and tilt. penByte carries the in range/tip bits
+static void fillPenReport(unsigned char* data, unsigned char reportId, unsigned char penByte, unsigned long i) {
+    int x = (int)(i * 37 % 60000);
+    int y = (int)(i * 53 % 34000);
+    int pressure = (int)(i % 8192);
+
+    data[0] = reportId;
+    data[1] = penByte;
+    data[2] = x & 0xff;
+    data[3] = (x >> 8) & 0xff;
+    data[4] = y & 0xff;
+    data[5] = (y >> 8) & 0xff;
+    data[6] = pressure & 0xff;
+    data[7] = (pressure >> 8) & 0xff;
+    data[8] = (unsigned char)(i % 60);
+    data[9] = (unsigned char)(-(int)(i % 60));
+}
+
+static unsigned long benchCapture(const char* path, input_sink* sink) {
+    report_capture_reader reader;
+    if (!reader.open(path)) {
+        return 0;
+    }
+
+    std::map<short, vendor_handler*> vendorHandlers;
+    device_database database;
+    database.load(device_database::getDefaultPath());
+
+    vendor_handler* xpPen = new xp_pen_handler(database);
+    vendor_handler* huion = new huion_handler(database);
+    vendorHandlers[xpPen->getVendorId()] = xpPen;
+    vendorHandlers[huion->getVendorId()] = huion;
+    for (auto handler : vendorHandlers) {
+        handler.second->setInputSink(sink);
+        handler.second->setConfig(nlohmann::json({}));
+    }
+
+    struct recorded_report {
+        transfer_handler* handler;
+        device_context* context;
+        int productId;
+        std::vector<unsigned char> data;
+    };
+
+    std::map<std::pair<short, short>, std::pair<transfer_handler*, device_context*> > devices;
+    std::vector<recorded_report> reports;
+    capture_record record;
+
+    while (reader.next(record)) {
+        auto deviceKey = std::make_pair(record.vendorId, record.productId);
+        if (record.type == capture_record_type::captureDevice) {
+            auto vendor = vendorHandlers.find(record.vendorId);
+            if (vendor == vendorHandlers.end() || vendor->second->getProductHandler(record.productId) == nullptr) {
+                continue;
+            }
+
+            auto productHandler = vendor->second->getProductHandler(record.productId);
+            auto handle = (libusb_device_handle*)(uintptr_t)(devices.size() + 1);
+            devices[deviceKey] = std::make_pair(productHandler,
+                                                productHandler->attachReplayDevice(handle, record.maxPressure));
+            productHandler->setOffsetPressure(record.productId);
+        } else {
+            auto device = devices.find(deviceKey);
+            if (device != devices.end()) {
+                reports.push_back({device->second.first, device->second.second, record.productId, record.data});
+            }
+        }
+    }
+
+    if (!reports.empty()) {
+        unsigned long iterations = reports.size() < 100000 ? 100000 : reports.size();
+        printResult(runBench(std::string("recorded reports (") + std::to_string(reports.size()) + ")", iterations,
+                             [&reports](unsigned long i) {
+            auto& report = reports[i % reports.size()];
+            report.handler->handleTransferData(report.context, report.data.data(), report.data.size(), report.productId);
+            report.handler->flushPendingEvents(report.context);
+        }));
+    }
+
+    for (auto handler : vendorHandlers) {
+        delete handler.second;
+    }
+
+    return reports.size();
+}
+
+int main(int argc, char** argv) {
+    const unsigned long iterations = 1000000;
+
+    memory_sink sink;
+
+    auto handle = (libusb_device_handle*)(uintptr_t)1;
+    unsigned char data[12] = {};
+
+    artist_24_pro artist24Pro;
+    artist24Pro.setInputSink(&sink);
+    artist24Pro.setConfig(nlohmann::json({}));
+    device_context* artist24ProContext = artist24Pro.attachReplayDevice(handle, 8191);
+
+    bench_artist_12_pro artist12Pro;
+    artist12Pro.setInputSink(&sink);
+    artist12Pro.setConfig(nlohmann::json({}));
+    device_context* artist12ProContext = artist12Pro.attachReplayDevice(handle, 8191);
+
+    device_database emptyDatabase;
+    huion_tablet huionTablet(0x006d, emptyDatabase);
+    huionTablet.setInputSink(&sink);
+    huionTablet.setConfig(nlohmann::json({}));
+    device_context* huionContext = huionTablet.attachReplayDevice(handle, 8191);
+
+    printResult(runBench("xp_pen decodeReport pen (Artist 24 Pro)", iterations, [&](unsigned long i) {
+        fillPenReport(data, 0x02, 0xa1, i);
+        artist24Pro.handleTransferData(artist24ProContext, data, 12, 0x0902);
+        artist24Pro.flushPendingEvents(artist24ProContext);
+    }));
+
+    printResult(runBench("xp_pen decodeReport pad (Artist 12 Pro)", iterations, [&](unsigned long i) {
+        memset(data, 0, sizeof(data));
+        data[0] = 0x02;
+        data[1] = 0xf0;
+        // Alternate between a button press, a release and a dial turn
+        switch (i % 3) {
+            case 0:
+                data[2] = 1 << (i % 8);
+                break;
+            case 1:
+                break;
+            case 2:
+                data[7] = (i & 4) ? 0x01 : 0x02;
+                break;
+        }
+        artist12Pro.handleTransferData(artist12ProContext, data, 10, 0x080a);
+        artist12Pro.flushPendingEvents(artist12ProContext);
+    }));
+
+    printResult(runBench("huion_tablet handleDigitizerEventV1", iterations, [&](unsigned long i) {
+        fillPenReport(data, 0x08, 0xc1, i);
+        huionTablet.handleTransferData(huionContext, data, 12, 0x006d);
+        huionTablet.flushPendingEvents(huionContext);
+    }));
+
+    printResult(runBench("huion_tablet handleDigitizerEventV2", iterations, [&](unsigned long i) {
+        fillPenReport(data, 0x08, 0x81, i);
+        data[10] = data[8];
+        data[11] = data[9];
+        data[8] = 0;
+        huionTablet.handleTransferData(huionContext, data, 12, 0x006d);
+        huionTablet.flushPendingEvents(huionContext);
+    }));
+
+    printResult(runBench("huion_tablet handleDigitizerEventV3", iterations, [&](unsigned long i) {
+        fillPenReport(data, 0x07, 0x81, i);
+        huionTablet.handleTransferData(huionContext, data, 12, 0x006d);
+        huionTablet.flushPendingEvents(huionContext);
+    }));
+
+    size_t mappedEvents = 0;
+    printResult(runBench("pad_mapping getPadMap", iterations, [&](unsigned long i) {
+        mappedEvents += artist12Pro.padMapping.getPadMap(BTN_0 + (int)(i % 8)).size();
+    }));
+
+    printResult(runBench("dial_mapping getDialMap", iterations, [&](unsigned long i) {
+        mappedEvents += artist12Pro.dialMapping.getDialMap(EV_REL, REL_WHEEL, (i & 1) ? 1 : -1).size();
+    }));
+
+    long pressureSum = 0;
+    printResult(runBench("applyPressureCurve", iterations, [&](unsigned long i) {
+        pressureSum += artist12Pro.applyPressureCurve((int)(i % 8192));
+    }));
+
+    // Unlike everything above this is mostly syscalls. The memory sink hands out /dev/null so every setup ioctl is
+    // still made, it just fails straight away instead of doing work in uinput
+    uinput_pad_args padArgs {
+            .padButtonAliases = artist12Pro.padButtonAliases,
+            .hasWheel = true,
+            .hasHWheel = false,
+            .wheelMax = 1,
+            .hWheelMax = 1,
+            .vendorId = 0x28bd,
+            .productId = 0xf80a,
+            .versionId = 0x0001,
+    };
+    printResult(runBench("create_pad (Artist 12 Pro) per device", 20000, [&](unsigned long i) {
+        int fd = artist12Pro.create_pad(nullptr, padArgs);
+        sink.closeDevice(fd);
+    }));
+
+    if (argc > 1) {
+        benchCapture(argv[1], &sink);
+    }
+
+    // Keeps the lookups from being optimised away
+    if (mappedEvents == 0 && pressureSum == 0) {
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include "report_capture_reader.h"
+#include "vendor_handler.h"
+#include "xp_pen_handler.h"
+#include "huion_handler.h"
+#include "memory_sink.h"
+
+// Feeds a capture written by the daemon back through the same transfer handlers without any hardware attached.
+// All output goes to a memory sink so what is measured is purely the parsing and dispatch.
+struct replay_device {
+public:
+    transfer_handler* handler;
+    device_context* context;
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <capture file> [driver.cfg]" << std::endl;
+        return 1;
+    }
+
+    report_capture_reader reader;
+    if (!reader.open(argv[1])) {
+        return 1;
+    }
+
+    memory_sink sink;
+
+    nlohmann::json driverConfigJson({});
+    if (argc > 2) {
+        std::ifstream driverConfig(argv[2], std::ifstream::in);
+        try {
+            driverConfig >> driverConfigJson;
+        } catch (const nlohmann::detail::parse_error&) {
+            std::cout << "Could not parse " << argv[2] << ", using the default mappings" << std::endl;
+        }
+    }
+
+    device_database database;
+    if (driverConfigJson.contains("deviceDatabase") && driverConfigJson["deviceDatabase"].is_string()) {
+        database.load(driverConfigJson["deviceDatabase"]);
+    } else {
+        database.load(device_database::getDefaultPath());
+    }
+
+    std::map<short, vendor_handler*> vendorHandlers;
+    vendor_handler* xpPen = new xp_pen_handler(database);
+    vendor_handler* huion = new huion_handler(database);
+    vendorHandlers[xpPen->getVendorId()] = xpPen;
+    vendorHandlers[huion->getVendorId()] = huion;
+
+    for (auto handler : vendorHandlers) {
+        auto vendorIdString = std::to_string(handler.first);
+        nlohmann::json vendorConfig({});
+        if (driverConfigJson.contains("deviceConfigurations") && driverConfigJson["deviceConfigurations"].contains(vendorIdString)) {
+            vendorConfig = driverConfigJson["deviceConfigurations"][vendorIdString];
+        }
+
+        handler.second->setInputSink(&sink);
+        handler.second->setConfig(vendorConfig);
+    }
+
+    std::map<std::pair<short, short>, replay_device> devices;
+    capture_record record;
+    unsigned long replayedReports = 0;
+    unsigned long skippedReports = 0;
+    std::chrono::nanoseconds elapsed(0);
+
+    while (reader.next(record)) {
+        auto deviceKey = std::make_pair(record.vendorId, record.productId);
+
+        if (record.type == capture_record_type::captureDevice) {
+            auto vendor = vendorHandlers.find(record.vendorId);
+            transfer_handler* productHandler = nullptr;
+            if (vendor != vendorHandlers.end()) {
+                productHandler = vendor->second->getProductHandler(record.productId);
+            }
+
+            if (productHandler == nullptr) {
+                std::cout << std::hex << "No handler for device " << record.vendorId << ":" << record.productId << std::dec << std::endl;
+                continue;
+            }
+
+            // There is no real device behind these so any unique pointer value will do as the handle
+            auto handle = (libusb_device_handle*)(uintptr_t)(devices.size() + 1);
+            device_context* context = productHandler->attachReplayDevice(handle, record.maxPressure);
+            productHandler->setOffsetPressure(record.productId);
+
+            devices[deviceKey] = {productHandler, context};
+            std::cout << "Replaying " << productHandler->getProductName(record.productId) << std::endl;
+            continue;
+        }
+
+        auto device = devices.find(deviceKey);
+        if (device == devices.end()) {
+            ++skippedReports;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        device->second.handler->handleTransferData(device->second.context, record.data.data(), record.data.size(), record.productId);
+        device->second.handler->flushPendingEvents(device->second.context);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        ++replayedReports;
+    }
+
+    std::cout << "Replayed " << replayedReports << " reports from " << devices.size() << " devices in "
+              << elapsed.count() / 1000000.0 << "ms";
+    if (replayedReports > 0) {
+        std::cout << " (" << elapsed.count() / replayedReports << "ns per report)";
+    }
+    std::cout << ", skipped " << skippedReports << std::endl;
+    std::cout << "Wrote " << sink.getEventCount() << " events in " << sink.getFrameCount() << " frames" << std::endl;
+
+    for (auto handler : vendorHandlers) {
+        delete handler.second;
+    }
+
+    return 0;
+}
@@ -22,23 +22,35 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <cstring>
 #include <iomanip>
+#include <algorithm>
 #include "transfer_handler.h"
-#include "socket_server.h"
+#include "probe_cache.h"
 
 transfer_handler::transfer_handler() {
-    penInProximity = false;
-    eraserInProximity = false;
-    penWasDown = false;
-    stylusButtonPressed = 0;
+    maxPressure = 0;
+    offsetPressure = 0;
+    inputSink = input_sink::getDefault();
+    devicePool = nullptr;
 }
 
 transfer_handler::~transfer_handler() {
-    for (auto pen : uinputPens) {
-        destroy_uinput_device(pen.second);
-    }
+    // Latency samples held by the sink point into the contexts
+    inputSink->submit();
 
-    for (auto pad : uinputPads) {
-        destroy_uinput_device(pad.second);
+    for (auto context : deviceContexts) {
+        if (context.second->pen.fd >= 0) {
+            destroy_uinput_device(context.second->pen.fd);
+        }
+
+        if (context.second->pad.fd >= 0) {
+            destroy_uinput_device(context.second->pad.fd);
+        }
+
+        if (context.second->pointer.fd >= 0) {
+            destroy_uinput_device(context.second->pointer.fd);
+        }
+
+        delete context.second;
     }
 }
 
@@ -46,94 +58,165 @@ std::vector<int> transfer_handler::handledProductIds() {
     return productIds;
 }
 
+void transfer_handler::addProduct(int productId, const std::string& name) {
+    if (std::find(productIds.begin(), productIds.end(), productId) == productIds.end()) {
+        productIds.push_back(productId);
+    }
+}
+
 nlohmann::json transfer_handler::getConfig() {
     return jsonConfig;
 }
 
-bool transfer_handler::uinput_send(int fd, uint16_t type, uint16_t code, int32_t value) {
-    struct timeval timestamp;
-    gettimeofday(&timestamp, NULL);
-    struct input_event event = {
-            .time = timestamp,
-            .type = type,
-            .code = code,
-            .value = value
-    };
-    if (write(fd, &event, sizeof(event)) < 0) {
+bool transfer_handler::uinput_send(uinput_device& device, uint16_t type, uint16_t code, int32_t value) {
+    if (device.fd < 0) {
         return false;
     }
 
+    if (!device.state.update(type, code, value)) {
+        return true;
+    }
+
+    if (!device.frame.append(type, code, value)) {
+        // The frame is unusually large so write out what we have and keep going. The kernel won't deliver
+        // anything until the SYN_REPORT anyway.
+        device.frame.flush(inputSink, device.fd);
+        device.frame.append(type, code, value);
+    }
+
+    if (type == EV_SYN && code == SYN_REPORT) {
+        // Nothing changed in this frame so there is nothing for the kernel to report
+        if (device.frame.size() == 1) {
+            device.frame.clear();
+            return true;
+        }
+
+        if (!device.frame.flush(inputSink, device.fd)) {
+            // We no longer know what the device has seen
+            device.state.invalidate();
+            return false;
+        }
+    }
+
     return true;
 }
 
-void transfer_handler::detachDevice(libusb_device_handle *handle) {
-    auto lastButtonRecord = lastPressedButton.find(handle);
-    if (lastButtonRecord != lastPressedButton.end()) {
-        lastPressedButton.erase(lastButtonRecord);
+void transfer_handler::flushPendingEvents(device_context* context) {
+    uinput_device* devices[] = {&context->pen, &context->pad, &context->pointer};
+    for (auto device : devices) {
+        if (!device->frame.empty()) {
+            device->frame.flush(inputSink, device->fd);
+        }
     }
+}
 
-    auto uinputPenRecord = uinputPens.find(handle);
-    if (uinputPenRecord != uinputPens.end()) {
-        close(uinputPens[handle]);
-        uinputPens.erase(uinputPenRecord);
+device_context* transfer_handler::getDeviceContext(libusb_device_handle *handle) {
+    auto record = deviceContexts.find(handle);
+    if (record != deviceContexts.end()) {
+        return record->second;
     }
 
-    auto uinputPadRecord = uinputPads.find(handle);
-    if (uinputPadRecord != uinputPads.end()) {
-        close(uinputPads[handle]);
-        uinputPads.erase(uinputPadRecord);
+    device_context* context = new device_context();
+    context->handle = handle;
+    deviceContexts[handle] = context;
+
+    return context;
+}
+
+device_context* transfer_handler::findDeviceContext(libusb_device_handle *handle) {
+    auto record = deviceContexts.find(handle);
+    if (record != deviceContexts.end()) {
+        return record->second;
     }
+
+    return nullptr;
 }
 
-std::vector<unix_socket_message*> transfer_handler::handleMessage(unix_socket_message *message) {
-    std::vector<unix_socket_message*> responses;
+int transfer_handler::getStringDescriptor(libusb_device_handle *handle, uint8_t index, unsigned char *data, int length) {
+    device_context* context = findDeviceContext(handle);
+    if (context != nullptr && context->probe != nullptr) {
+        return context->probe->getStringDescriptor(handle, index, data, length);
+    }
 
-    for (auto pens : uinputPens) {
-        int sentBytes;
-        int ret = libusb_interrupt_transfer(pens.first, message->interface | LIBUSB_ENDPOINT_OUT, message->data, message->length, &sentBytes, 1000);
-        if (ret != LIBUSB_SUCCESS) {
-            std::cout << "Failed to send message on interface " << message->interface << " ret: " << ret << " errno: " << errno << std::endl;
-            return std::vector<unix_socket_message*>();
-        }
+    return libusb_get_string_descriptor(handle, index, 0x0409, data, length);
+}
 
-        if (sentBytes != message->length) {
-            std::cout << "Didn't send all of the message on interface " << message->interface << " only sent " << sentBytes << std::endl;
-            return std::vector<unix_socket_message*>();
-        }
+std::string transfer_handler::getPortPath(libusb_device_handle *handle) {
+    if (handle == nullptr) {
+        return "";
+    }
 
-        if (message->expectResponse) {
-            unix_socket_message* response = new unix_socket_message();
-            response->destination = message_destination::gui;
-            response->vendor = message->vendor;
-            response->device = message->device;
-            response->interface = message->interface;
-            response->length = message->responseLength;
-            response->originatingSocket = message->originatingSocket;
-            response->signature = socket_server::versionSignature;
-            response->data = new unsigned char[response->length];
-            int actual_length;
-            int ret = libusb_interrupt_transfer(pens.first, message->responseInterface | LIBUSB_ENDPOINT_IN, response->data, response->length, &actual_length, 1000);
-            if (ret != LIBUSB_SUCCESS) {
-                std::cout << "Could not receive response on interface " << message->responseInterface << " ret: " << ret << " errno: " << errno << std::endl;
-                delete[] response->data;
-                delete response;
-            } else {
-                if (actual_length != message->responseLength) {
-                    std::cout << "Got a response of " << actual_length << " bytes. Expected " << message->responseLength
-                              << std::endl;
-                } else {
-                    responses.push_back(response);
-                }
-            }
+    return probe_cache::portPath(libusb_get_device(handle));
+}
+
+device_context* transfer_handler::releaseDeviceContext(libusb_device_handle *handle) {
+    auto record = deviceContexts.find(handle);
+    if (record == deviceContexts.end()) {
+        return nullptr;
+    }
+
+    device_context* context = record->second;
+    deviceContexts.erase(record);
+
+    return context;
+}
+
+void transfer_handler::adoptDeviceContext(device_context* context) {
+    auto record = deviceContexts.find(context->handle);
+    if (record != deviceContexts.end()) {
+        inputSink->submit();
+        delete record->second;
+    }
+
+    deviceContexts[context->handle] = context;
+}
+
+void transfer_handler::detachDevice(libusb_device_handle *handle) {
+    auto record = deviceContexts.find(handle);
+    if (record == deviceContexts.end()) {
+        return;
+    }
+
+    device_context* context = record->second;
+    // Frames still held by the sink have to land before the devices are parked, and latency samples held by the sink
+    // point into the context
+    inputSink->submit();
+
+    release_uinput_device(context->pen);
+    release_uinput_device(context->pad);
+    release_uinput_device(context->pointer);
+
+    deviceContexts.erase(record);
+    delete context;
+}
+
+std::vector<libusb_device_handle*> transfer_handler::getMessageTargets(unix_socket_message *message) {
+    std::vector<libusb_device_handle*> targets;
+
+    for (auto context : deviceContexts) {
+        // Only devices with a digitizer have the interface these messages are meant for
+        if (context.second->pen.fd < 0) {
+            continue;
         }
+
+        targets.push_back(context.first);
     }
 
-    return responses;
+    return targets;
 }
 
-int transfer_handler::create_pen(const uinput_pen_args& penArgs) {
+int transfer_handler::create_pen(libusb_device_handle* handle, const uinput_pen_args& penArgs) {
+    std::string poolKey;
+    if (devicePool != nullptr) {
+        poolKey = uinput_device_pool::keyFor(getPortPath(handle), penArgs);
+        int pooledFd = devicePool->take(poolKey);
+        if (pooledFd >= 0) {
+            return pooledFd;
+        }
+    }
+
     int fd = -1;
-    fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    fd = inputSink->openDevice();
     if (fd < 0) {
         std::cout << "Could not create uinput pen (" << std::strerror(errno) << ")" << std::endl;
         return fd;
@@ -271,12 +354,34 @@ int transfer_handler::create_pen(const uinput_pen_args& penArgs) {
     ioctl(fd, UI_DEV_SETUP, &uinput_setup);
     ioctl(fd, UI_DEV_CREATE);
 
+    if (devicePool != nullptr) {
+        devicePool->track(fd, poolKey);
+    }
+
     return fd;
 }
 
-int transfer_handler::create_pad(const uinput_pad_args& padArgs) {
+int transfer_handler::create_pad(libusb_device_handle* handle, const uinput_pad_args& padArgs) {
+    // This is for all of the pad buttons, along with whatever they and the dials are mapped to
+    std::bitset<KEY_CNT> keys = padKeyCapabilities;
+    for (auto button : padArgs.padButtonAliases) {
+        if (button >= 0 && button < KEY_CNT) {
+            keys.set(button);
+        }
+    }
+
+    std::string poolKey;
+    if (devicePool != nullptr) {
+        poolKey = uinput_device_pool::keyFor(getPortPath(handle), padArgs, keys);
+        int pooledFd = devicePool->take(poolKey);
+        if (pooledFd >= 0) {
+            padDevices[pooledFd] = {padArgs, keys};
+            return pooledFd;
+        }
+    }
+
     int fd = -1;
-    fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    fd = inputSink->openDevice();
     if (fd < 0) {
         std::cout << "Could not create uinput pad" << std::endl;
         return fd;
@@ -307,14 +412,10 @@ int transfer_handler::create_pad(const uinput_pad_args& padArgs) {
     set_evbit(EV_ABS);
     set_evbit(EV_REL);
 
-    // This is for all of the pad buttons
-    for (int index = 0; index < padArgs.padButtonAliases.size(); ++index) {
-        set_keybit(padArgs.padButtonAliases[index]);
-    }
-
-    // But we also send through all the keys since they can be mapped
-    for (int index = KEY_RESERVED; index <= KEY_MICMUTE; ++index) {
-        set_keybit(index);
+    for (int code = 0; code < KEY_CNT; ++code) {
+        if (keys.test(code)) {
+            set_keybit(code);
+        }
     }
 
     set_relbit(REL_X);
@@ -366,12 +467,27 @@ int transfer_handler::create_pad(const uinput_pad_args& padArgs) {
     ioctl(fd, UI_DEV_SETUP, &uinput_setup);
     ioctl(fd, UI_DEV_CREATE);
 
+    if (devicePool != nullptr) {
+        devicePool->track(fd, poolKey);
+    }
+
+    padDevices[fd] = {padArgs, keys};
+
     return fd;
 }
 
-int transfer_handler::create_pointer(const uinput_pointer_args &pointerArgs) {
+int transfer_handler::create_pointer(libusb_device_handle* handle, const uinput_pointer_args &pointerArgs) {
+    std::string poolKey;
+    if (devicePool != nullptr) {
+        poolKey = uinput_device_pool::keyFor(getPortPath(handle), pointerArgs);
+        int pooledFd = devicePool->take(poolKey);
+        if (pooledFd >= 0) {
+            return pooledFd;
+        }
+    }
+
     int fd = -1;
-    fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    fd = inputSink->openDevice();
     if (fd < 0) {
         std::cout << "Could not create uinput pointer" << std::endl;
         return false;
@@ -410,11 +526,52 @@ int transfer_handler::create_pointer(const uinput_pointer_args &pointerArgs) {
     ioctl(fd, UI_DEV_SETUP, &uinput_setup);
     ioctl(fd, UI_DEV_CREATE);
 
+    if (devicePool != nullptr) {
+        devicePool->track(fd, poolKey);
+    }
+
     return fd;
 }
 
 void transfer_handler::destroy_uinput_device(int fd) {
-    ioctl(fd, UI_DEV_DESTROY);
+    inputSink->destroyDevice(fd);
+}
+
+void transfer_handler::release_uinput_device(uinput_device& device) {
+    if (device.fd < 0) {
+        return;
+    }
+
+    padDevices.erase(device.fd);
+
+    if (devicePool != nullptr) {
+        // Let go of anything still held so nothing is stuck down while the device waits for its tablet
+        for (auto key : device.state.getPressedKeys()) {
+            uinput_send(device, EV_KEY, key, 0);
+        }
+        uinput_send(device, EV_SYN, SYN_REPORT, 1);
+        device.frame.clear();
+
+        if (devicePool->release(device.fd)) {
+            device.fd = -1;
+            return;
+        }
+    }
+
+    inputSink->closeDevice(device.fd);
+    device.fd = -1;
+}
+
+void transfer_handler::recordLatency(device_context *context, std::chrono::steady_clock::time_point receivedAt) {
+    inputSink->recordLatency(context->latency, receivedAt);
+}
+
+void transfer_handler::setInputSink(input_sink* sink) {
+    inputSink = sink;
+}
+
+void transfer_handler::setDevicePool(uinput_device_pool* pool) {
+    devicePool = pool;
 }
 
 void transfer_handler::submitMapping(const nlohmann::json& config) {
@@ -432,6 +589,7 @@ void transfer_handler::submitMapping(const nlohmann::json& config) {
                             scanCodes.push_back(newEvent);
                         }
                     }
+                    addPadKeyCapabilities(scanCodes);
                     stylusButtonMapping.setStylusButtonMap(std::atoi(mappingStylusButtons.key().c_str()), scanCodes);
                     scanCodes.clear();
                 }
@@ -446,6 +604,7 @@ void transfer_handler::submitMapping(const nlohmann::json& config) {
                             scanCodes.push_back(newEvent);
                         }
                     }
+                    addPadKeyCapabilities(scanCodes);
                     padMapping.setPadMap(std::atoi(mappingButtons.key().c_str()), scanCodes);
                     scanCodes.clear();
                 }
@@ -464,6 +623,7 @@ void transfer_handler::submitMapping(const nlohmann::json& config) {
                                 scanCodes.push_back(newEvent);
                             }
                         }
+                        addPadKeyCapabilities(scanCodes);
                         dialMapping.setDialMap(std::atoi(mappingDials.key().c_str()), interceptValues.key(), scanCodes);
                         scanCodes.clear();
                     }
@@ -508,9 +668,45 @@ void transfer_handler::submitMapping(const nlohmann::json& config) {
         pressureCurve.emplace_back(std::pair(0, 0));
         pressureCurve.emplace_back(std::pair(100, 100));
     }
+
+    buildPressureTable();
+
+    refreshPadDevices();
+}
+
+void transfer_handler::addPadKeyCapabilities(const std::vector<aliased_input_event>& events) {
+    for (auto& event : events) {
+        if (event.event_type == EV_KEY && event.event_value >= 0 && event.event_value < KEY_CNT) {
+            padKeyCapabilities.set(event.event_value);
+        }
+    }
 }
 
-void transfer_handler::handleUnknownUsbMessage(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
+void transfer_handler::refreshPadDevices() {
+    for (auto context : deviceContexts) {
+        auto pad = padDevices.find(context.second->pad.fd);
+        if (pad == padDevices.end() || (padKeyCapabilities & ~pad->second.keys).none()) {
+            continue;
+        }
+
+        uinput_pad_args padArgs = pad->second.args;
+        int oldFd = pad->first;
+        padDevices.erase(pad);
+
+        std::cout << "Recreating pad device to add newly mapped keys" << std::endl;
+        if (devicePool != nullptr) {
+            devicePool->forget(oldFd);
+        }
+        destroy_uinput_device(oldFd);
+        inputSink->closeDevice(oldFd);
+
+        context.second->pad.frame.clear();
+        context.second->pad.state.invalidate();
+        context.second->pad.fd = create_pad(context.first, padArgs);
+    }
+}
+
+void transfer_handler::handleUnknownUsbMessage(device_context* context, unsigned char *data, size_t dataLen) {
     std::cout << std::dec << "Got unknown message transfer of data length: " << (int)dataLen << " data: ";
     for (int i = 0; i < dataLen; ++i) {
         std::cout << std::hex << std::setfill('0')  << std::setw(2) << (int)data[i] << ":";
@@ -518,127 +714,135 @@ void transfer_handler::handleUnknownUsbMessage(libusb_device_handle *handle, uns
     std::cout << std::endl;
 }
 
-void transfer_handler::handleEraserEnteredProximity(libusb_device_handle* handle) {
-    if (!eraserInProximity) {
-        uinput_send(uinputPens[handle], EV_KEY, BTN_TOOL_RUBBER, 1);
+void transfer_handler::handleEraserEnteredProximity(device_context* context) {
+    if (!context->eraserInProximity) {
+        context->pen.state.invalidate();
+        uinput_send(context->pen, EV_KEY, BTN_TOOL_RUBBER, 1);
         if (hasCustomButtonMap(BTN_TOOL_RUBBER)) {
-            handleStylusMappedEvent(handle, BTN_TOOL_RUBBER, 1);
-            handleStylusMappedEvent(handle, BTN_TOOL_RUBBER, 0);
+            handleStylusMappedEvent(context, BTN_TOOL_RUBBER, 1);
+            handleStylusMappedEvent(context, BTN_TOOL_RUBBER, 0);
         }
-        eraserInProximity = true;
+        context->eraserInProximity = true;
     }
 }
-void transfer_handler::handleEraserLeftProximity(libusb_device_handle* handle) {
-    uinput_send(uinputPens[handle], EV_KEY, BTN_TOOL_RUBBER, 0);
-    eraserInProximity = false;
+void transfer_handler::handleEraserLeftProximity(device_context* context) {
+    uinput_send(context->pen, EV_KEY, BTN_TOOL_RUBBER, 0);
+    if (context->eraserInProximity) {
+        context->pen.state.invalidate();
+    }
+    context->eraserInProximity = false;
 }
-void transfer_handler::handlePenEnteredProximity(libusb_device_handle* handle) {
-    if (!penInProximity) {
-        uinput_send(uinputPens[handle], EV_KEY, BTN_TOOL_PEN, 1);
+void transfer_handler::handlePenEnteredProximity(device_context* context) {
+    if (!context->penInProximity) {
+        context->pen.state.invalidate();
+        uinput_send(context->pen, EV_KEY, BTN_TOOL_PEN, 1);
         if (hasCustomButtonMap(BTN_TOOL_PEN)) {
-            handleStylusMappedEvent(handle, BTN_TOOL_PEN, 1);
-            handleStylusMappedEvent(handle, BTN_TOOL_PEN, 0);
+            handleStylusMappedEvent(context, BTN_TOOL_PEN, 1);
+            handleStylusMappedEvent(context, BTN_TOOL_PEN, 0);
         }
-        penInProximity = true;
+        context->penInProximity = true;
     }
 }
 
-void transfer_handler::handlePenLeftProximity(libusb_device_handle* handle) {
-    uinput_send(uinputPens[handle], EV_KEY, BTN_TOOL_PEN, 0);
-    penInProximity = false;
+void transfer_handler::handlePenLeftProximity(device_context* context) {
+    uinput_send(context->pen, EV_KEY, BTN_TOOL_PEN, 0);
+    if (context->penInProximity) {
+        context->pen.state.invalidate();
+    }
+    context->penInProximity = false;
 }
 
-void transfer_handler::handlePenTouchingDigitizer(libusb_device_handle *handle, int pressure) {
-    uinput_send(uinputPens[handle], EV_KEY, BTN_TOUCH, (pressure != 0) ? 1 : 0);
-    uinput_send(uinputPens[handle], EV_ABS, ABS_PRESSURE, pressure);
+void transfer_handler::handlePenTouchingDigitizer(device_context* context, int pressure) {
+    uinput_send(context->pen, EV_KEY, BTN_TOUCH, (pressure != 0) ? 1 : 0);
+    uinput_send(context->pen, EV_ABS, ABS_PRESSURE, pressure);
 }
 
 bool transfer_handler::hasCustomButtonMap(int button) {
     return !stylusButtonMapping.getStylusButtonMap(button).empty();
 }
 
-void transfer_handler::handleStylusMappedEvent(libusb_device_handle *handle, int event, int value) {
+void transfer_handler::handleStylusMappedEvent(device_context* context, int event, int value) {
     auto stylusButtonMap = stylusButtonMapping.getStylusButtonMap(event);
     if (!stylusButtonMap.empty()) {
         for (auto sbMap: stylusButtonMap) {
-            uinput_send(uinputPads[handle], sbMap.event_type, sbMap.event_value, value);
+            uinput_send(context->pad, sbMap.event_type, sbMap.event_value, value);
         }
-        uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+        uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
     } else {
-        uinput_send(uinputPens[handle], EV_KEY, event, value);
+        uinput_send(context->pen, EV_KEY, event, value);
     }
 }
 
-void transfer_handler::handleStylusButtonsPressed(libusb_device_handle *handle, int stylusButton) {
+void transfer_handler::handleStylusButtonsPressed(device_context* context, int stylusButton) {
     auto iterator = stylusButtonDisabled.find(stylusButton);
     if (iterator == stylusButtonDisabled.end()) {
-        handleStylusMappedEvent(handle, stylusButton, 1);
-        stylusButtonPressed = stylusButton;
+        handleStylusMappedEvent(context, stylusButton, 1);
+        context->stylusButtonPressed = stylusButton;
     }
 }
 
-void transfer_handler::handleStylusButtonUnpressed(libusb_device_handle *handle) {
-    auto iterator = stylusButtonDisabled.find(stylusButtonPressed);
+void transfer_handler::handleStylusButtonUnpressed(device_context* context) {
+    auto iterator = stylusButtonDisabled.find(context->stylusButtonPressed);
     if (iterator == stylusButtonDisabled.end()) {
-        handleStylusMappedEvent(handle, stylusButtonPressed, 0);
-        stylusButtonPressed = 0;
+        handleStylusMappedEvent(context, context->stylusButtonPressed, 0);
+        context->stylusButtonPressed = 0;
     }
 }
 
-void transfer_handler::handleCoordsAndTilt(libusb_device_handle *handle, int penX, int penY, short tiltX, short tiltY) {
-    handleCoords(handle, penX, penY);
-    uinput_send(uinputPens[handle], EV_ABS, ABS_TILT_X, tiltX);
-    uinput_send(uinputPens[handle], EV_ABS, ABS_TILT_Y, tiltY);
+void transfer_handler::handleCoordsAndTilt(device_context* context, int penX, int penY, short tiltX, short tiltY) {
+    handleCoords(context, penX, penY);
+    uinput_send(context->pen, EV_ABS, ABS_TILT_X, tiltX);
+    uinput_send(context->pen, EV_ABS, ABS_TILT_Y, tiltY);
 }
 
-void transfer_handler::handleCoords(libusb_device_handle *handle, int penX, int penY) {
-    uinput_send(uinputPens[handle], EV_ABS, ABS_X, penX);
-    uinput_send(uinputPens[handle], EV_ABS, ABS_Y, penY);
+void transfer_handler::handleCoords(device_context* context, int penX, int penY) {
+    uinput_send(context->pen, EV_ABS, ABS_X, penX);
+    uinput_send(context->pen, EV_ABS, ABS_Y, penY);
 }
 
-void transfer_handler::handlePadButtonPressed(libusb_device_handle *handle, int button) {
+void transfer_handler::handlePadButtonPressed(device_context* context, int button) {
     auto iterator = padButtonDisabled.find(button);
     if (iterator == padButtonDisabled.end()) {
         auto padMap = padMapping.getPadMap(padButtonAliases[button - 1]);
         for (auto pmap: padMap) {
-            uinput_send(uinputPads[handle], pmap.event_type, pmap.event_value, 1);
+            uinput_send(context->pad, pmap.event_type, pmap.event_value, 1);
         }
-        lastPressedButton[handle] = button;
+        context->lastPressedButton = button;
     }
 }
 
-void transfer_handler::handlePadButtonUnpressed(libusb_device_handle *handle) {
-    if (lastPressedButton.find(handle) != lastPressedButton.end() && lastPressedButton[handle] > 0) {
-        auto padMap = padMapping.getPadMap(padButtonAliases[lastPressedButton[handle] - 1]);
+void transfer_handler::handlePadButtonUnpressed(device_context* context) {
+    if (context->lastPressedButton > 0) {
+        auto padMap = padMapping.getPadMap(padButtonAliases[context->lastPressedButton - 1]);
         for (auto pmap : padMap) {
-            uinput_send(uinputPads[handle], pmap.event_type, pmap.event_value, 0);
+            uinput_send(context->pad, pmap.event_type, pmap.event_value, 0);
         }
-        lastPressedButton[handle] = -1;
+        context->lastPressedButton = -1;
     }
 }
 
-void transfer_handler::handleDialEvent(libusb_device_handle* handle, int dial, short value) {
+void transfer_handler::handleDialEvent(device_context* context, int dial, short value) {
     auto iterator = dialDisabled.find(dial);
     if (iterator == dialDisabled.end()) {
         bool send_reset = false;
         auto dialMap = dialMapping.getDialMap(EV_REL, dial, value);
         for (auto dmap: dialMap) {
-            uinput_send(uinputPads[handle], dmap.event_type, dmap.event_value, dmap.event_data);
+            uinput_send(context->pad, dmap.event_type, dmap.event_value, dmap.event_data);
             if (dmap.event_type == EV_KEY) {
                 send_reset = true;
             }
         }
 
-        uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+        uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
 
         if (send_reset) {
             for (auto dmap: dialMap) {
                 // We have to handle key presses manually here because this device does not send reset events
                 if (dmap.event_type == EV_KEY) {
-                    uinput_send(uinputPads[handle], dmap.event_type, dmap.event_value, 0);
+                    uinput_send(context->pad, dmap.event_type, dmap.event_value, 0);
                 }
             }
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
+            uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
         }
     }
 }
@@ -649,7 +853,58 @@ float transfer_handler::getPoint(float n1, float n2, float dt) {
     return n1 + (diff * dt);
 }
 
+int transfer_handler::getMaxPressure() {
+    return maxPressure;
+}
+
+device_context* transfer_handler::attachReplayDevice(libusb_device_handle *handle, int maxPressure) {
+    device_context* context = getDeviceContext(handle);
+    if (context->pen.fd < 0) {
+        context->pen.fd = inputSink->openDevice();
+    }
+
+    if (context->pad.fd < 0) {
+        context->pad.fd = inputSink->openDevice();
+    }
+
+    if (context->pointer.fd < 0) {
+        context->pointer.fd = inputSink->openDevice();
+    }
+
+    setMaxPressure(maxPressure);
+
+    return context;
+}
+
+void transfer_handler::setMaxPressure(int pressure) {
+    if (pressure != maxPressure) {
+        maxPressure = pressure;
+        buildPressureTable();
+    }
+}
+
+void transfer_handler::buildPressureTable() {
+    pressureTable.clear();
+    if (maxPressure <= 0) {
+        return;
+    }
+
+    pressureTable.resize(maxPressure + 1);
+    for (int pressure = 0; pressure <= maxPressure; ++pressure) {
+        pressureTable[pressure] = evaluatePressureCurve(pressure);
+    }
+}
+
 int transfer_handler::applyPressureCurve(int pressure) {
+    if (pressure >= 0 && pressure < (int)pressureTable.size()) {
+        return pressureTable[pressure];
+    }
+
+    // Only reached before the device has been probed or if it reports more than its own maximum
+    return evaluatePressureCurve(pressure);
+}
+
+int transfer_handler::evaluatePressureCurve(int pressure) {
     if (pressureCurve.empty() || pressure == 0) {
         return pressure;
     }
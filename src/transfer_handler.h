@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <string>
 #include <bitset>
+#include <map>
 #include <unordered_set>
 #include "uinput_pen_args.h"
 #include "uinput_pad_args.h"
@@ -33,6 +34,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pad_mapping.h"
 #include "dial_mapping.h"
 #include "unix_socket_message.h"
+#include "device_context.h"
+#include "input_sink.h"
+#include "uinput_device_pool.h"
 
 class transfer_handler {
 public:
@@ -40,6 +44,8 @@ public:
     virtual ~transfer_handler();
 
     virtual std::vector<int> handledProductIds();
+    // Makes the handler answer for another product id, as used for variants listed in the device database
+    virtual void addProduct(int productId, const std::string& name);
     virtual std::string getProductName(int productId) = 0;
     virtual void setConfig(nlohmann::json config) = 0;
     virtual nlohmann::json getConfig();
@@ -48,58 +54,108 @@ public:
     virtual bool attachToInterfaceId(int interfaceId) = 0;
     virtual bool attachDevice(libusb_device_handle* handle, int interfaceId, int productId) = 0;
     virtual void detachDevice(libusb_device_handle* handle);
-    virtual bool handleTransferData(libusb_device_handle* handle, unsigned char* data, size_t dataLen, int productId) = 0;
-    virtual std::vector<unix_socket_message*> handleMessage(unix_socket_message* message);
+    // Finds the context of an attached device, creating it the first time the handle is seen
+    virtual device_context* getDeviceContext(libusb_device_handle* handle);
+    // Like getDeviceContext but returns nullptr instead of creating one
+    device_context* findDeviceContext(libusb_device_handle* handle);
+    // Hands a context over to another handler, as happens when a device turns out to be an aliased product
+    device_context* releaseDeviceContext(libusb_device_handle* handle);
+    void adoptDeviceContext(device_context* context);
+    virtual bool handleTransferData(device_context* context, unsigned char* data, size_t dataLen, int productId) = 0;
+    // The attached devices a GUI message is sent to
+    virtual std::vector<libusb_device_handle*> getMessageTargets(unix_socket_message* message);
     virtual bool isAliasedProduct(int productId) { return false; }
     virtual int getAliasedProductId(libusb_device_handle* handle, int originalId) { return originalId; }
     virtual std::string getInitKey() = 0;
+
+    // Writes out any events that were queued without a trailing SYN_REPORT
+    virtual void flushPendingEvents(device_context* context);
+    // Adds how long a report took from its usb completion until its frames reached the kernel to the device's
+    // histogram. The input sink decides when that is
+    void recordLatency(device_context* context, std::chrono::steady_clock::time_point receivedAt);
+
+    // Where the uinput devices of this handler are created and written to. Must be set before any device attaches
+    void setInputSink(input_sink* sink);
+    // Where the devices of a detached tablet wait in case it comes back. Without one they are closed straight away
+    void setDevicePool(uinput_device_pool* pool);
+
+    int getMaxPressure();
+    // Sets up a device that has no hardware behind it, as used when replaying a capture. The devices are opened on
+    // the input sink without being set up, so this is meant to be used with the memory sink
+    device_context* attachReplayDevice(libusb_device_handle* handle, int maxPressure);
 protected:
-    virtual bool uinput_send(int fd, uint16_t type, uint16_t code, int32_t value);
-    virtual int create_pen(const uinput_pen_args& penArgs);
-    virtual int create_pad(const uinput_pad_args& padArgs);
-    virtual int create_pointer(const uinput_pointer_args& pointerArgs);
+    virtual bool uinput_send(uinput_device& device, uint16_t type, uint16_t code, int32_t value);
+    // The handle is the tablet the device is for, so the device pool can give it back its own devices
+    virtual int create_pen(libusb_device_handle* handle, const uinput_pen_args& penArgs);
+    virtual int create_pad(libusb_device_handle* handle, const uinput_pad_args& padArgs);
+    virtual int create_pointer(libusb_device_handle* handle, const uinput_pointer_args& pointerArgs);
     virtual void destroy_uinput_device(int fd);
+    // Parks the device in the pool if there is one or closes it otherwise
+    virtual void release_uinput_device(uinput_device& device);
 
     virtual void submitMapping(const nlohmann::json& config);
+    // Recreates any attached pad that can't send a key the mapping now needs
+    virtual void refreshPadDevices();
+    void addPadKeyCapabilities(const std::vector<aliased_input_event>& events);
+
+    // libusb_get_string_descriptor answered from the probe cache when the device was seen before. Only for descriptors
+    // that are pure information, some tablets change their report mode when certain descriptors are read
+    int getStringDescriptor(libusb_device_handle* handle, uint8_t index, unsigned char* data, int length);
+    // Where the tablet is plugged in, or an empty string for devices without hardware behind them
+    std::string getPortPath(libusb_device_handle* handle);
 
     virtual bool hasCustomButtonMap(int button);
 
-    virtual void handleUnknownUsbMessage(libusb_device_handle *handle, unsigned char *data, size_t dataLen);
+    virtual void handleUnknownUsbMessage(device_context* context, unsigned char *data, size_t dataLen);
 
-    virtual void handleEraserEnteredProximity(libusb_device_handle* handle);
-    virtual void handleEraserLeftProximity(libusb_device_handle* handle);
+    virtual void handleEraserEnteredProximity(device_context* context);
+    virtual void handleEraserLeftProximity(device_context* context);
 
-    virtual void handlePenEnteredProximity(libusb_device_handle* handle);
-    virtual void handlePenLeftProximity(libusb_device_handle* handle);
+    virtual void handlePenEnteredProximity(device_context* context);
+    virtual void handlePenLeftProximity(device_context* context);
 
-    virtual void handlePenTouchingDigitizer(libusb_device_handle* handle, int pressure);
+    virtual void handlePenTouchingDigitizer(device_context* context, int pressure);
 
-    virtual void handleStylusMappedEvent(libusb_device_handle *handle, int event, int value);
+    virtual void handleStylusMappedEvent(device_context* context, int event, int value);
 
-    virtual void handleStylusButtonsPressed(libusb_device_handle* handle, int stylusButton);
-    virtual void handleStylusButtonUnpressed(libusb_device_handle* handle);
+    virtual void handleStylusButtonsPressed(device_context* context, int stylusButton);
+    virtual void handleStylusButtonUnpressed(device_context* context);
 
-    virtual void handleCoordsAndTilt(libusb_device_handle* handle, int penX, int penY, short tiltX, short tiltY);
-    virtual void handleCoords(libusb_device_handle* handle, int penX, int penY);
+    virtual void handleCoordsAndTilt(device_context* context, int penX, int penY, short tiltX, short tiltY);
+    virtual void handleCoords(device_context* context, int penX, int penY);
 
-    virtual void handlePadButtonPressed(libusb_device_handle* handle, int button);
-    virtual void handlePadButtonUnpressed(libusb_device_handle* handle);
+    virtual void handlePadButtonPressed(device_context* context, int button);
+    virtual void handlePadButtonUnpressed(device_context* context);
 
-    virtual void handleDialEvent(libusb_device_handle* handle, int dial, short value);
+    virtual void handleDialEvent(device_context* context, int dial, short value);
 
+    virtual void setMaxPressure(int pressure);
+    virtual void buildPressureTable();
     virtual int applyPressureCurve(int pressure);
+    virtual int evaluatePressureCurve(int pressure);
     virtual float evaluateBezier(const std::vector<std::pair<float, float>>& points, float t);
 
     std::vector<int> productIds;
+    input_sink* inputSink;
+    uinput_device_pool* devicePool;
 
-    std::map<libusb_device_handle*, int> uinputPens;
-    std::map<libusb_device_handle*, int> uinputPads;
-    std::map<libusb_device_handle*, int> uinputPointers;
-
-    std::map<libusb_device_handle*, long> lastPressedButton;
+    // Only touched on attach, detach and control messages. The event path gets its context through the transfer.
+    std::map<libusb_device_handle*, device_context*> deviceContexts;
 
     std::vector<int> padButtonAliases;
 
+    // Every key the mappings can send through a pad. Pads only advertise these and their own buttons, which saves
+    // an ioctl for each of the few hundred keys that would otherwise be advertised just in case. Keys are only ever
+    // added since the mapping tables never forget a mapping either.
+    std::bitset<KEY_CNT> padKeyCapabilities;
+
+    struct pad_device {
+        uinput_pad_args args;
+        std::bitset<KEY_CNT> keys;
+    };
+    // How each live pad was created, keyed by its fd, so it can be created again with more keys
+    std::map<int, pad_device> padDevices;
+
     stylus_button_mapping stylusButtonMapping;
     std::unordered_set<int> stylusButtonDisabled;
     pad_mapping padMapping;
@@ -108,12 +164,9 @@ protected:
     std::unordered_set<int> dialDisabled;
     nlohmann::json jsonConfig;
 
-    bool penInProximity;
-    bool eraserInProximity;
-    bool penWasDown;
-    int stylusButtonPressed;
-
     std::vector<std::pair<float, float> > pressureCurve;
+    // pressureCurve evaluated for every raw pressure value from 0 to maxPressure
+    std::vector<int> pressureTable;
     int maxPressure;
     int offsetPressure;
 
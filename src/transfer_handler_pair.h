@@ -23,6 +23,8 @@ struct transfer_handler_pair {
 public:
     vendor_handler* vendorHandler;
     transfer_handler* transferHandler;
+    device_context* context;
+    report_capture* capture;
     int productId;
 };
 
@@ -0,0 +1,225 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "transfer_ring.h"
+#include "control_transfer.h"
+
+transfer_ring::transfer_ring(const transfer_handler_pair& dataPair, short vendorId) {
+    this->dataPair = dataPair;
+    this->vendorId = vendorId;
+    handle = nullptr;
+    endpoint = 0;
+    inFlight = 0;
+    cancelled = false;
+    nextSubmitSequence = 0;
+    nextCompletionSequence = 0;
+    completions = 0;
+    overruns = 0;
+    timeouts = 0;
+    resubmitFailures = 0;
+    reorderedCompletions = 0;
+}
+
+transfer_ring::~transfer_ring() {
+    std::cout << std::dec << "Transfer ring for product " << dataPair.productId << " handled " << completions
+              << " reports with " << overruns << " overruns, " << timeouts << " timeouts, "
+              << resubmitFailures << " failed resubmits and " << reorderedCompletions << " out of order completions"
+              << std::endl;
+
+    for (auto& ringSlot : slots) {
+        if (ringSlot.transfer != nullptr) {
+            delete[] ringSlot.transfer->buffer;
+            libusb_free_transfer(ringSlot.transfer);
+        }
+    }
+}
+
+bool transfer_ring::submit(libusb_device_handle *handle, unsigned char endpoint, int maxPacketSize, int transferCount) {
+    this->handle = handle;
+    this->endpoint = endpoint;
+
+    // The slots are handed to libusb by address so they must never be reallocated after this point
+    slots.resize(transferCount);
+
+    for (auto& ringSlot : slots) {
+        ringSlot.ring = this;
+        ringSlot.sequence = 0;
+        ringSlot.inFlight = false;
+        ringSlot.transfer = libusb_alloc_transfer(0);
+        if (ringSlot.transfer == NULL) {
+            std::cout << "Could not allocate a transfer for endpoint " << (int)endpoint << std::endl;
+            continue;
+        }
+
+        unsigned char* buff = new unsigned char[maxPacketSize];
+        libusb_fill_interrupt_transfer(ringSlot.transfer,
+                                       handle, endpoint | LIBUSB_ENDPOINT_IN,
+                                       buff, maxPacketSize,
+                                       transferCallback, &ringSlot,
+                                       60000);
+
+        if (!submitSlot(&ringSlot)) {
+            std::cout << "Could not submit transfer on endpoint " << (int)endpoint << " errno: " << errno << std::endl;
+        }
+    }
+
+    return inFlight > 0;
+}
+
+void transfer_ring::cancel() {
+    cancelled = true;
+    for (auto& ringSlot : slots) {
+        if (ringSlot.inFlight) {
+            libusb_cancel_transfer(ringSlot.transfer);
+        }
+    }
+}
+
+bool transfer_ring::isIdle() const {
+    return inFlight == 0;
+}
+
+libusb_device_handle* transfer_ring::getHandle() const {
+    return handle;
+}
+
+unsigned char transfer_ring::getEndpoint() const {
+    return endpoint;
+}
+
+void transfer_ring::addResponseWaiter(control_transfer *waiter) {
+    responseWaiters.push_back(waiter);
+}
+
+void transfer_ring::removeResponseWaiter(control_transfer *waiter) {
+    auto record = std::find(responseWaiters.begin(), responseWaiters.end(), waiter);
+    if (record != responseWaiters.end()) {
+        responseWaiters.erase(record);
+    }
+}
+
+bool transfer_ring::submitSlot(slot* ringSlot) {
+    ringSlot->sequence = nextSubmitSequence;
+    if (libusb_submit_transfer(ringSlot->transfer) != LIBUSB_SUCCESS) {
+        return false;
+    }
+
+    ringSlot->inFlight = true;
+    ++nextSubmitSequence;
+    ++inFlight;
+    return true;
+}
+
+void transfer_ring::transferCallback(struct libusb_transfer *transfer) {
+    auto receivedAt = std::chrono::steady_clock::now();
+    auto ringSlot = (slot*)transfer->user_data;
+    ringSlot->ring->handleCompletion(ringSlot, receivedAt);
+}
+
+void transfer_ring::handleCompletion(slot* ringSlot, std::chrono::steady_clock::time_point receivedAt) {
+    ringSlot->inFlight = false;
+    --inFlight;
+
+    // Transfers on an endpoint are queued in order so they should also come back in order
+    if (ringSlot->sequence != nextCompletionSequence) {
+        ++reorderedCompletions;
+    }
+    nextCompletionSequence = ringSlot->sequence + 1;
+
+    // Whoever owns the ring is waiting for it to go idle and the device context may already be gone
+    if (cancelled) {
+        return;
+    }
+
+    auto transfer = ringSlot->transfer;
+    switch (transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+            ++completions;
+
+            if (dataPair.capture != nullptr && dataPair.capture->isOpen()) {
+                dataPair.capture->writeReport(vendorId, dataPair.productId, endpoint,
+                                              dataPair.transferHandler->getMaxPressure(),
+                                              std::chrono::duration_cast<std::chrono::nanoseconds>(receivedAt.time_since_epoch()).count(),
+                                              transfer->buffer, transfer->actual_length);
+            }
+
+            if (!responseWaiters.empty()) {
+                // The waiter may be finished and freed by handling this so it is taken off the queue first
+                auto waiter = responseWaiters.front();
+                responseWaiters.pop_front();
+                waiter->handleResponse(transfer->buffer, transfer->actual_length);
+            } else {
+                // Send the packet data to the registered handler
+                dataPair.transferHandler->handleTransferData(dataPair.context, transfer->buffer, transfer->actual_length, dataPair.productId);
+                dataPair.transferHandler->flushPendingEvents(dataPair.context);
+                dataPair.transferHandler->recordLatency(dataPair.context, receivedAt);
+            }
+
+            if (!submitSlot(ringSlot)) {
+                ++resubmitFailures;
+                std::cout << "Could not resubmit my transfer" << std::endl;
+            } else if (inFlight == 1) {
+                // Only the transfer we just put back is queued, so the controller had nothing to fill while we
+                // were handling this one
+                ++overruns;
+            }
+
+            break;
+
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            ++timeouts;
+            if (!submitSlot(ringSlot)) {
+                ++resubmitFailures;
+                std::cout << "Could not resubmit my transfer" << std::endl;
+            }
+
+            break;
+
+        case LIBUSB_TRANSFER_CANCELLED:
+            break;
+
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            break;
+
+        default:
+            std::cout << "Unknown status received " << transfer->status << std::endl;
+            break;
+    }
+}
+
+unsigned long transfer_ring::getCompletions() const {
+    return completions;
+}
+
+unsigned long transfer_ring::getOverruns() const {
+    return overruns;
+}
+
+unsigned long transfer_ring::getTimeouts() const {
+    return timeouts;
+}
+
+unsigned long transfer_ring::getResubmitFailures() const {
+    return resubmitFailures;
+}
+
+unsigned long transfer_ring::getReorderedCompletions() const {
+    return reorderedCompletions;
+}
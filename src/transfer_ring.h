@@ -0,0 +1,97 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_TRANSFER_RING_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_TRANSFER_RING_H
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <libusb-1.0/libusb.h>
+#include "transfer_handler.h"
+
+#include "report_capture.h"
+
+class vendor_handler;
+class control_transfer;
+#include "transfer_handler_pair.h"
+
+// A fixed set of interrupt transfers kept in flight on one IN endpoint. Having more than one queued means the
+// controller always has somewhere to put the next report while we are busy handling the previous one.
+//
+// The transfers, their buffers and the user data libusb hands back are allocated once in submit() and live as long
+// as the ring. The ring is owned by its vendor handler which may only delete it once it is idle.
+class transfer_ring {
+public:
+    transfer_ring(const transfer_handler_pair& dataPair, short vendorId);
+    ~transfer_ring();
+
+    bool submit(libusb_device_handle* handle, unsigned char endpoint, int maxPacketSize, int transferCount);
+
+    // Cancels every transfer in flight for good
+    void cancel();
+    // True once libusb has handed back every transfer
+    bool isIdle() const;
+    libusb_device_handle* getHandle() const;
+    unsigned char getEndpoint() const;
+
+    // The device answers control requests on the endpoint we are already reading so the next report after the
+    // request went out is handed to the waiting request instead of being decoded
+    void addResponseWaiter(control_transfer* waiter);
+    void removeResponseWaiter(control_transfer* waiter);
+
+    unsigned long getCompletions() const;
+    unsigned long getOverruns() const;
+    unsigned long getTimeouts() const;
+    unsigned long getResubmitFailures() const;
+    unsigned long getReorderedCompletions() const;
+
+private:
+    struct slot {
+        transfer_ring* ring;
+        libusb_transfer* transfer;
+        unsigned long sequence;
+        bool inFlight;
+    };
+
+    static void LIBUSB_CALL transferCallback(struct libusb_transfer* transfer);
+    void handleCompletion(slot* ringSlot, std::chrono::steady_clock::time_point receivedAt);
+    bool submitSlot(slot* ringSlot);
+
+    transfer_handler_pair dataPair;
+    short vendorId;
+    libusb_device_handle* handle;
+    unsigned char endpoint;
+    std::vector<slot> slots;
+    std::deque<control_transfer*> responseWaiters;
+    int inFlight;
+    bool cancelled;
+
+    unsigned long nextSubmitSequence;
+    unsigned long nextCompletionSequence;
+
+    unsigned long completions;
+    // Completions after which only the resubmitted transfer was queued, so the device may have had nowhere to report
+    // to while the completion was handled. Failed resubmits are counted on their own
+    unsigned long overruns;
+    unsigned long timeouts;
+    unsigned long resubmitFailures;
+    unsigned long reorderedCompletions;
+};
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_TRANSFER_RING_H
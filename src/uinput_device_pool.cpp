@@ -0,0 +1,180 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include "uinput_device_pool.h"
+#include "usb_event_thread.h"
+
+uinput_device_pool::uinput_device_pool(input_sink* sink) {
+    this->sink = sink;
+    reactor = nullptr;
+    usbThread = nullptr;
+    gracePeriod = std::chrono::seconds(0);
+}
+
+uinput_device_pool::~uinput_device_pool() {
+    for (auto& parked : parkedDevices) {
+        destroy(parked.fd);
+    }
+}
+
+void uinput_device_pool::setGracePeriod(int seconds) {
+    std::lock_guard<std::mutex> guard(lock);
+    gracePeriod = std::chrono::seconds(seconds > 0 ? seconds : 0);
+}
+
+void uinput_device_pool::setReactor(event_reactor* reactor) {
+    this->reactor = reactor;
+}
+
+void uinput_device_pool::setUsbThread(usb_event_thread* thread) {
+    usbThread = thread;
+}
+
+int uinput_device_pool::take(const std::string& key) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto parked = parkedDevices.begin(); parked != parkedDevices.end(); ++parked) {
+        if (parked->key == key) {
+            int fd = parked->fd;
+            parkedDevices.erase(parked);
+            liveDevices[fd] = key;
+
+            std::cout << "Reusing uinput device " << fd << std::endl;
+            return fd;
+        }
+    }
+
+    return -1;
+}
+
+void uinput_device_pool::track(int fd, const std::string& key) {
+    if (fd < 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    liveDevices[fd] = key;
+}
+
+bool uinput_device_pool::release(int fd) {
+    std::chrono::seconds delay;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto live = liveDevices.find(fd);
+        if (live == liveDevices.end()) {
+            return false;
+        }
+
+        std::string key = live->second;
+        liveDevices.erase(live);
+
+        if (gracePeriod.count() == 0) {
+            return false;
+        }
+
+        parkedDevices.push_back({fd, key, std::chrono::steady_clock::now() + gracePeriod});
+        delay = gracePeriod;
+    }
+
+    // The timer fires on the reactor's thread but destroying a device touches the sink, which the usb thread could be
+    // writing to at the same time
+    if (reactor == nullptr || !reactor->addTimer(std::chrono::duration_cast<std::chrono::milliseconds>(delay).count(), [this]() {
+        if (usbThread != nullptr) {
+            usbThread->post([this]() {
+                expire();
+            });
+        } else {
+            expire();
+        }
+    })) {
+        // Nothing will wake us up later so at least get rid of anything that is already overdue
+        expire();
+    }
+
+    return true;
+}
+
+void uinput_device_pool::forget(int fd) {
+    std::lock_guard<std::mutex> guard(lock);
+    liveDevices.erase(fd);
+}
+
+void uinput_device_pool::expire() {
+    std::vector<int> expired;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto now = std::chrono::steady_clock::now();
+        for (auto parked = parkedDevices.begin(); parked != parkedDevices.end();) {
+            if (parked->expiry <= now) {
+                expired.push_back(parked->fd);
+                parked = parkedDevices.erase(parked);
+            } else {
+                ++parked;
+            }
+        }
+    }
+
+    for (auto fd : expired) {
+        std::cout << "Grace period over for uinput device " << fd << std::endl;
+        destroy(fd);
+    }
+}
+
+void uinput_device_pool::destroy(int fd) {
+    sink->destroyDevice(fd);
+    sink->closeDevice(fd);
+}
+
+std::string uinput_device_pool::keyFor(const std::string& portPath, const uinput_pen_args& penArgs) {
+    std::stringstream key;
+    key << "pen:" << portPath << ":" << penArgs.vendorId << ":" << penArgs.productId << ":" << penArgs.versionId << ":"
+        << penArgs.maxWidth << ":" << penArgs.maxHeight << ":" << penArgs.maxPressure << ":" << penArgs.resolution
+        << ":" << penArgs.maxTiltX << ":" << penArgs.maxTiltY << ":"
+        << std::string(penArgs.productName, strnlen(penArgs.productName, UINPUT_MAX_NAME_SIZE));
+
+    return key.str();
+}
+
+std::string uinput_device_pool::keyFor(const std::string& portPath, const uinput_pad_args& padArgs, const std::bitset<KEY_CNT>& keys) {
+    std::stringstream key;
+    key << "pad:" << portPath << ":" << padArgs.vendorId << ":" << padArgs.productId << ":" << padArgs.versionId << ":"
+        << padArgs.hasWheel << padArgs.hasHWheel << ":" << padArgs.wheelMax << ":" << padArgs.hWheelMax << ":";
+    for (auto button : padArgs.padButtonAliases) {
+        key << button << ",";
+    }
+    key << ":";
+    for (int code = 0; code < KEY_CNT; ++code) {
+        if (keys.test(code)) {
+            key << code << ",";
+        }
+    }
+    key << ":" << std::string(padArgs.productName, strnlen(padArgs.productName, UINPUT_MAX_NAME_SIZE));
+
+    return key.str();
+}
+
+std::string uinput_device_pool::keyFor(const std::string& portPath, const uinput_pointer_args& pointerArgs) {
+    std::stringstream key;
+    key << "pointer:" << portPath << ":" << pointerArgs.vendorId << ":" << pointerArgs.productId << ":" << pointerArgs.versionId << ":"
+        << pointerArgs.wheelMax << ":"
+        << std::string(pointerArgs.productName, strnlen(pointerArgs.productName, UINPUT_MAX_NAME_SIZE));
+
+    return key.str();
+}
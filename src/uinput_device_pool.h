@@ -0,0 +1,92 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_DEVICE_POOL_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_DEVICE_POOL_H
+
+#include <bitset>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "input_sink.h"
+#include "event_reactor.h"
+#include "uinput_pen_args.h"
+#include "uinput_pad_args.h"
+#include "uinput_pointer_args.h"
+
+class usb_event_thread;
+
+// Keeps the virtual devices of an unplugged tablet around for a grace period. If the tablet comes back in that time
+// (a USB glitch or a KVM switch) it is handed the same devices instead of new ones. Setting up a pad is a few hundred
+// ioctls, and a new device makes the compositor and libinput enumerate it all over again.
+//
+// Devices are matched by the USB port of their tablet and the arguments they were created with, so a tablet only ever
+// gets back its own devices, even when an identical tablet is plugged in next to it, and only if they look exactly
+// like the ones it would have created.
+class uinput_device_pool {
+public:
+    explicit uinput_device_pool(input_sink* sink);
+    ~uinput_device_pool();
+
+    // 0 turns the pool off and devices are closed as soon as their tablet goes away
+    void setGracePeriod(int seconds);
+    // Used to schedule expiry. Without one, expired devices are only cleaned up on the next release
+    void setReactor(event_reactor* reactor);
+    // Devices are written to from the usb thread so the sink may only be touched there. When set, expiry that the
+    // reactor schedules is handed over to it
+    void setUsbThread(usb_event_thread* thread);
+
+    // A parked device created from the same arguments or -1 if there is none
+    int take(const std::string& key);
+    // Remembers how a newly created device was set up so it can be parked later
+    void track(int fd, const std::string& key);
+    // Parks a device created through this pool. Returns false if the caller should close it instead
+    bool release(int fd);
+    // For devices that are being closed for good while their tablet is still attached
+    void forget(int fd);
+    // Destroys every parked device whose grace period is over
+    void expire();
+
+    // portPath is where the tablet is plugged in, as given by probe_cache::portPath
+    static std::string keyFor(const std::string& portPath, const uinput_pen_args& penArgs);
+    static std::string keyFor(const std::string& portPath, const uinput_pad_args& padArgs, const std::bitset<KEY_CNT>& keys);
+    static std::string keyFor(const std::string& portPath, const uinput_pointer_args& pointerArgs);
+private:
+    struct parked_device {
+        int fd;
+        std::string key;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    void destroy(int fd);
+
+    input_sink* sink;
+    event_reactor* reactor;
+    usb_event_thread* usbThread;
+    std::chrono::seconds gracePeriod;
+
+    // Attach and detach happen on different threads
+    std::mutex lock;
+    std::unordered_map<int, std::string> liveDevices;
+    std::vector<parked_device> parkedDevices;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_DEVICE_POOL_H
@@ -0,0 +1,55 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/time.h>
+#include "uinput_event_frame.h"
+
+uinput_event_frame::uinput_event_frame() {
+    count = 0;
+}
+
+bool uinput_event_frame::append(uint16_t type, uint16_t code, int32_t value) {
+    if (count == maxEvents) {
+        return false;
+    }
+
+    struct input_event& event = events[count++];
+    event.type = type;
+    event.code = code;
+    event.value = value;
+
+    return true;
+}
+
+bool uinput_event_frame::flush(input_sink* sink, int fd) {
+    if (count == 0) {
+        return true;
+    }
+
+    // Every event in a frame happened at the same time so they all share one timestamp
+    struct timeval timestamp;
+    gettimeofday(&timestamp, NULL);
+    for (size_t i = 0; i < count; ++i) {
+        events[i].time = timestamp;
+    }
+
+    size_t frameCount = count;
+    count = 0;
+
+    return sink->writeEvents(fd, events, frameCount);
+}
@@ -0,0 +1,48 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_EVENT_FRAME_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_EVENT_FRAME_H
+
+#include <linux/input.h>
+#include <cstdint>
+#include <cstddef>
+#include "input_sink.h"
+
+// Collects the events of a single input frame so they can be handed to the input sink in one go once the
+// SYN_REPORT arrives.
+class uinput_event_frame {
+public:
+    uinput_event_frame();
+
+    // Returns false if the frame is full and has to be flushed first
+    bool append(uint16_t type, uint16_t code, int32_t value);
+    bool flush(input_sink* sink, int fd);
+    void clear() { count = 0; }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+private:
+    static const size_t maxEvents = 64;
+
+    struct input_event events[maxEvents];
+    size_t count;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_EVENT_FRAME_H
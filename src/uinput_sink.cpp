@@ -0,0 +1,51 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include "uinput_sink.h"
+
+std::string uinput_sink::name() {
+    return "uinput";
+}
+
+int uinput_sink::openDevice() {
+    return open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+}
+
+void uinput_sink::destroyDevice(int fd) {
+    ioctl(fd, UI_DEV_DESTROY);
+}
+
+void uinput_sink::closeDevice(int fd) {
+    close(fd);
+}
+
+bool uinput_sink::writeEvents(int fd, const struct input_event *events, size_t count) {
+    const size_t frameSize = count * sizeof(struct input_event);
+
+    ssize_t written;
+    do {
+        written = write(fd, events, frameSize);
+    } while (written < 0 && errno == EINTR);
+
+    return written == (ssize_t)frameSize;
+}
@@ -16,14 +16,22 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#ifndef USERSPACE_TABLET_DRIVER_DAEMON_TRANSFER_SETUP_DATA_H
-#define USERSPACE_TABLET_DRIVER_DAEMON_TRANSFER_SETUP_DATA_H
-
-struct transfer_setup_data {
-    libusb_device_handle *handle;
-    unsigned char interface_number;
-    int maxPacketSize;
-    int productId;
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_SINK_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_SINK_H
+
+#include "input_sink.h"
+
+// Real /dev/uinput devices with one blocking write per frame
+class uinput_sink : public input_sink {
+public:
+    std::string name() override;
+
+    int openDevice() override;
+    void destroyDevice(int fd) override;
+    void closeDevice(int fd) override;
+
+    bool writeEvents(int fd, const struct input_event* events, size_t count) override;
 };
 
-#endif //USERSPACE_TABLET_DRIVER_DAEMON_TRANSFER_SETUP_DATA_H
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_SINK_H
@@ -0,0 +1,73 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "uinput_state_cache.h"
+
+uinput_state_cache::uinput_state_cache() {
+    invalidate();
+}
+
+bool uinput_state_cache::update(uint16_t type, uint16_t code, int32_t value) {
+    switch (type) {
+        case EV_KEY:
+            if (code >= KEY_CNT) {
+                return true;
+            }
+
+            if (keyKnown.test(code) && keyValues[code] == value) {
+                return false;
+            }
+
+            keyKnown.set(code);
+            keyValues[code] = value;
+            return true;
+
+        case EV_ABS:
+            if (code >= ABS_CNT) {
+                return true;
+            }
+
+            if (absKnown.test(code) && absValues[code] == value) {
+                return false;
+            }
+
+            absKnown.set(code);
+            absValues[code] = value;
+            return true;
+
+        default:
+            // Relative, misc and sync events always carry new information
+            return true;
+    }
+}
+
+std::vector<uint16_t> uinput_state_cache::getPressedKeys() const {
+    std::vector<uint16_t> pressedKeys;
+    for (uint16_t code = 0; code < KEY_CNT; ++code) {
+        if (keyKnown.test(code) && keyValues[code] != 0) {
+            pressedKeys.push_back(code);
+        }
+    }
+
+    return pressedKeys;
+}
+
+void uinput_state_cache::invalidate() {
+    keyKnown.reset();
+    absKnown.reset();
+}
@@ -0,0 +1,46 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_STATE_CACHE_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_STATE_CACHE_H
+
+#include <linux/input.h>
+#include <cstdint>
+#include <bitset>
+#include <vector>
+
+// Remembers the last key and absolute axis values written to a uinput device so that unchanged values can be
+// dropped before they cost us a syscall. The kernel would discard them anyway.
+class uinput_state_cache {
+public:
+    uinput_state_cache();
+
+    // Records the value and returns true if it differs from what the device already has
+    bool update(uint16_t type, uint16_t code, int32_t value);
+    void invalidate();
+    // Keys that were last sent as pressed or repeating
+    std::vector<uint16_t> getPressedKeys() const;
+private:
+    std::bitset<KEY_CNT> keyKnown;
+    std::bitset<ABS_CNT> absKnown;
+    int32_t keyValues[KEY_CNT];
+    int32_t absValues[ABS_CNT];
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_UINPUT_STATE_CACHE_H
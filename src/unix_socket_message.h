@@ -37,6 +37,8 @@ struct unix_socket_message {
     int originatingSocket;
     long signature;
     unsigned char* data;
+    // Handed out by the socket server and never sent over the socket. Responses carry the id of their request.
+    unsigned long requestId;
 };
 
 struct unix_socket_message_header {
@@ -16,49 +16,123 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
 #include <iostream>
 #include "unix_socket_message_queue.h"
 
 unix_socket_message_queue::unix_socket_message_queue() {
-    messages[message_destination::driver] = std::map<short, std::vector<unix_socket_message*> >();
-    messages[message_destination::gui] = std::map<short, std::vector<unix_socket_message*> >();
+    for (auto& destinationStaged : staged) {
+        destinationStaged.reserve(ringCapacity);
+    }
+
+    responseFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (responseFd == -1) {
+        std::cout << "Could not create response eventfd errno: " << errno << std::endl;
+    }
 }
 
 unix_socket_message_queue::~unix_socket_message_queue() {
+    for (int destination = 0; destination < destinationCount; ++destination) {
+        releaseMessagesFor((message_destination)destination);
+    }
+
+    if (responseFd != -1) {
+        close(responseFd);
+    }
+}
 
+unix_socket_message* unix_socket_message_queue::createMessage(long dataLength) {
+    return pool.acquire(dataLength);
 }
 
-void unix_socket_message_queue::addMessage(unix_socket_message *message) {
+void unix_socket_message_queue::releaseMessage(unix_socket_message *message) {
+    pool.release(message);
+}
+
+bool unix_socket_message_queue::addMessage(unix_socket_message *message) {
     if (message == nullptr) {
-        return;
+        return false;
+    }
+
+    if (message->destination < 0 || message->destination >= destinationCount) {
+        std::cout << "Dropping message for unknown destination " << message->destination << std::endl;
+        releaseMessage(message);
+        return false;
+    }
+
+    message_destination destination = message->destination;
+    if (!rings[destination].push(message)) {
+        std::cout << "Dropping message because the queue for destination " << destination << " is full" << std::endl;
+        releaseMessage(message);
+        return false;
     }
 
-    auto record = messages[message->destination].find(message->vendor);
-    if (record == messages[message->destination].end()) {
-        messages[message->destination][message->vendor] = std::vector<unix_socket_message*>();
+    if (destination == message_destination::gui && responseFd != -1) {
+        uint64_t wake = 1;
+        if (write(responseFd, &wake, sizeof(wake)) != sizeof(wake)) {
+            std::cout << "Could not signal a queued response errno: " << errno << std::endl;
+        }
     }
 
-    messages[message->destination][message->vendor].push_back(message);
+    return true;
 }
 
-std::vector<unix_socket_message*> unix_socket_message_queue::getMessagesFor(message_destination destination, short vendor) {
-    auto record = messages[destination].find(vendor);
-    if (record != messages[destination].end() && record->second.size() > 0) {
-        auto returnedItems = std::vector<unix_socket_message*>(record->second);
-        record->second.clear();
-        return returnedItems;
+bool unix_socket_message_queue::hasMessagesFor(message_destination destination) {
+    return !rings[destination].empty() || !staged[destination].empty();
+}
+
+void unix_socket_message_queue::drainRing(message_destination destination) {
+    unix_socket_message* message;
+    while (rings[destination].pop(message)) {
+        staged[destination].push_back(message);
+    }
+}
+
+size_t unix_socket_message_queue::getMessagesFor(message_destination destination, short vendor, std::vector<unix_socket_message*>& messages) {
+    messages.clear();
+    drainRing(destination);
+
+    // Keep the messages of other vendors in order for whoever reads them next
+    auto& destinationStaged = staged[destination];
+    size_t kept = 0;
+    for (auto message : destinationStaged) {
+        if (message->vendor == vendor) {
+            messages.push_back(message);
+        } else {
+            destinationStaged[kept++] = message;
+        }
     }
+    destinationStaged.resize(kept);
 
-    return std::vector<unix_socket_message*>();
+    return messages.size();
 }
 
-std::vector<unix_socket_message*> unix_socket_message_queue::getResponses() {
-    auto returnedItems = std::vector<unix_socket_message*>();
-    for (auto it = messages[message_destination::gui].begin(); it != messages[message_destination::gui].end(); ++it) {
-        returnedItems.insert(returnedItems.end(), it->second.begin(), it->second.end());
+size_t unix_socket_message_queue::getResponses(std::vector<unix_socket_message*>& responses) {
+    responses.clear();
+    drainRing(message_destination::gui);
+
+    auto& destinationStaged = staged[message_destination::gui];
+    responses.insert(responses.end(), destinationStaged.begin(), destinationStaged.end());
+    destinationStaged.clear();
+
+    return responses.size();
+}
+
+size_t unix_socket_message_queue::releaseMessagesFor(message_destination destination) {
+    drainRing(destination);
+
+    auto& destinationStaged = staged[destination];
+    size_t released = destinationStaged.size();
+    for (auto message : destinationStaged) {
+        releaseMessage(message);
     }
+    destinationStaged.clear();
 
-    messages[message_destination::gui].clear();
+    return released;
+}
 
-    return returnedItems;
+int unix_socket_message_queue::getResponseFd() {
+    return responseFd;
 }
@@ -21,19 +21,44 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include "unix_socket_message.h"
+#include "mpmc_queue.h"
+#include "message_pool.h"
 #include <vector>
-#include <map>
 
+// One lock-free ring per destination. Messages for the driver and the event handler come from the socket server
+// while responses are added from the usb thread whenever a device answers, so any thread may add a message but
+// each destination is only ever read by one thread. Responses also poke an eventfd to wake the control thread that
+// writes them out.
 class unix_socket_message_queue {
 public:
     unix_socket_message_queue();
     ~unix_socket_message_queue();
 
-    void addMessage(unix_socket_message* message);
-    std::vector<unix_socket_message*> getMessagesFor(message_destination destination, short vendor);
-    std::vector<unix_socket_message*> getResponses();
+    // Every message added has to come from here and goes back with releaseMessage once it has been handled
+    unix_socket_message* createMessage(long dataLength);
+    void releaseMessage(unix_socket_message* message);
+
+    // Takes ownership of the message. Returns false and releases it if the ring of its destination is full.
+    bool addMessage(unix_socket_message* message);
+    bool hasMessagesFor(message_destination destination);
+    // Replaces the contents of messages with everything queued for the vendor and returns how many there were
+    size_t getMessagesFor(message_destination destination, short vendor, std::vector<unix_socket_message*>& messages);
+    size_t getResponses(std::vector<unix_socket_message*>& responses);
+    // Releases whatever nobody took, like messages for a vendor we have no handler for
+    size_t releaseMessagesFor(message_destination destination);
+    // Readable whenever a response was added
+    int getResponseFd();
 private:
-    std::map<message_destination, std::map<short, std::vector<unix_socket_message*> > > messages;
+    static const size_t ringCapacity = 256;
+    static const int destinationCount = message_destination::gui + 1;
+
+    void drainRing(message_destination destination);
+
+    message_pool pool;
+    mpmc_queue<unix_socket_message*, ringCapacity> rings[destinationCount];
+    // Messages taken off a ring that belong to another vendor than the one asking. Only touched by the reader.
+    std::vector<unix_socket_message*> staged[destinationCount];
+    int responseFd;
 };
 
 
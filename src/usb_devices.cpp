@@ -25,11 +25,70 @@ usb_devices::usb_devices() {
 //    libusb_set_option(context, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_DEBUG);
 }
 
-void usb_devices::handleEvents() {
+void usb_devices::handleEvents(int timeoutMs) {
+    // The reactor only calls this once one of the libusb fds is ready (or a libusb timeout expired) so it never
+    // wants to block in here. A timeout is only given when a handler has to wait for its transfers to come back.
     struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 1;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
     libusb_handle_events_timeout_completed(context, &tv, NULL);
+    eventsPending = false;
+}
+
+void usb_devices::attachToReactor(event_reactor* eventReactor) {
+    reactor = eventReactor;
+
+    const struct libusb_pollfd** pollfds = libusb_get_pollfds(context);
+    if (pollfds != NULL) {
+        for (int i = 0; pollfds[i] != NULL; ++i) {
+            pollfdAdded(pollfds[i]->fd, pollfds[i]->events, this);
+        }
+        libusb_free_pollfds(pollfds);
+    }
+
+    libusb_set_pollfd_notifiers(context, pollfdAdded, pollfdRemoved, this);
+}
+
+int usb_devices::getNextTimeoutMs() {
+    // On linux libusb drives its own timeouts through a timerfd that is part of the pollfd set
+    if (libusb_pollfds_handle_timeouts(context)) {
+        return -1;
+    }
+
+    struct timeval tv;
+    int ret = libusb_get_next_timeout(context, &tv);
+    if (ret == 0) {
+        return -1;
+    } else if (ret < 0) {
+        // Fall back to polling relatively often if libusb can't tell us
+        return 100;
+    }
+
+    // Round up so we don't wake up just before the timeout expires
+    return tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+}
+
+void usb_devices::pollfdAdded(int fd, short events, void *user_data) {
+    usb_devices* devices = (usb_devices*)user_data;
+    if (devices->reactor == nullptr) {
+        return;
+    }
+
+    // poll and epoll share the same bit values for POLLIN/POLLOUT
+    devices->reactor->addFd(fd, events, [devices](uint32_t readyEvents) {
+        devices->eventsPending = true;
+    });
+}
+
+void usb_devices::pollfdRemoved(int fd, void *user_data) {
+    usb_devices* devices = (usb_devices*)user_data;
+    if (devices->reactor != nullptr) {
+        devices->reactor->removeFd(fd);
+    }
+}
+
+bool usb_devices::hasPendingEvents() {
+    return eventsPending;
 }
 
 libusb_context* usb_devices::getContext() {
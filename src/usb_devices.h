@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <libusb-1.0/libusb.h>
 #include <map>
 #include "vendor_handler.h"
+#include "event_reactor.h"
 
 class usb_devices {
 public:
@@ -29,14 +30,23 @@ public:
 
     libusb_context* getContext();
 
-    void handleEvents();
+    void handleEvents(int timeoutMs = 0);
+    void attachToReactor(event_reactor* reactor);
+    int getNextTimeoutMs();
+    bool hasPendingEvents();
 
     std::map<short, std::vector<short> > getCandidateDevices(const std::map<short, vendor_handler*> vendorHandlers);
     void handleDeviceAttach(const std::map<short, vendor_handler*> vendorHandlers, struct libusb_device* device);
     void handleDeviceDetach(const std::map<short, vendor_handler *> vendorHandlers, struct libusb_device* device);
 private:
+    static void LIBUSB_CALL pollfdAdded(int fd, short events, void* user_data);
+    static void LIBUSB_CALL pollfdRemoved(int fd, void* user_data);
+
     libusb_context *context = NULL;
     libusb_device **lusb_list = NULL;
+
+    event_reactor* reactor = nullptr;
+    bool eventsPending = false;
 };
 
 
@@ -0,0 +1,175 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include "usb_event_thread.h"
+
+usb_event_thread::usb_event_thread() {
+    devices = nullptr;
+    inputSink = nullptr;
+    running = false;
+    priority = 0;
+    cpu = -1;
+
+    commandFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (commandFd == -1) {
+        std::cout << "Could not create usb thread eventfd errno: " << errno << std::endl;
+    }
+}
+
+usb_event_thread::~usb_event_thread() {
+    stop();
+
+    if (commandFd != -1) {
+        close(commandFd);
+    }
+}
+
+bool usb_event_thread::start(usb_devices* usbDevices, int threadPriority, int threadCpu) {
+    if (running || commandFd == -1 || !reactor.isValid()) {
+        return false;
+    }
+
+    devices = usbDevices;
+    priority = threadPriority;
+    cpu = threadCpu;
+
+    reactor.addFd(commandFd, EPOLLIN, [this](uint32_t events) {
+        drainCommands();
+    });
+    devices->attachToReactor(&reactor);
+
+    running = true;
+    thread = std::thread(&usb_event_thread::run, this);
+    threadId = thread.get_id();
+
+    return true;
+}
+
+void usb_event_thread::stop() {
+    if (!running) {
+        return;
+    }
+
+    post([this]() {
+        running = false;
+    });
+    thread.join();
+
+    // Anything still queued was posted after the stop request so run it here instead of dropping it
+    drainCommands();
+}
+
+bool usb_event_thread::isRunning() {
+    return running;
+}
+
+void usb_event_thread::setInputSink(input_sink* sink) {
+    inputSink = sink;
+}
+
+void usb_event_thread::post(command cmd) {
+    // The command queue is tiny and only full if the usb thread is badly behind, so just wait for room
+    while (!commands.push(std::move(cmd))) {
+        std::this_thread::yield();
+    }
+
+    uint64_t wake = 1;
+    if (write(commandFd, &wake, sizeof(wake)) != sizeof(wake)) {
+        std::cout << "Could not wake usb thread errno: " << errno << std::endl;
+    }
+}
+
+void usb_event_thread::invoke(command cmd) {
+    if (!running || std::this_thread::get_id() == threadId) {
+        cmd();
+        return;
+    }
+
+    std::promise<void> done;
+    post([&cmd, &done]() {
+        cmd();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+void usb_event_thread::serviceEvents(int timeoutMs) {
+    if (devices != nullptr) {
+        devices->handleEvents(timeoutMs);
+    }
+}
+
+void usb_event_thread::drainCommands() {
+    uint64_t count;
+    while (read(commandFd, &count, sizeof(count)) == sizeof(count)) {
+    }
+
+    command cmd;
+    while (commands.pop(cmd)) {
+        cmd();
+    }
+}
+
+void usb_event_thread::applyScheduling() {
+    if (priority > 0) {
+        struct sched_param param {};
+        param.sched_priority = priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            std::cout << "Could not set SCHED_FIFO priority " << priority << " on usb thread: " << strerror(err) << std::endl;
+        } else {
+            std::cout << "Usb thread running with SCHED_FIFO priority " << priority << std::endl;
+        }
+    }
+
+    if (cpu >= 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if (err != 0) {
+            std::cout << "Could not pin usb thread to cpu " << cpu << ": " << strerror(err) << std::endl;
+        } else {
+            std::cout << "Usb thread pinned to cpu " << cpu << std::endl;
+        }
+    }
+}
+
+void usb_event_thread::run() {
+    applyScheduling();
+
+    while (running) {
+        // Sleep until a USB transfer completes, libusb needs a timeout handled or the control thread hands us work
+        int ready = reactor.wait(devices->getNextTimeoutMs());
+        if (ready == 0 || devices->hasPendingEvents()) {
+            devices->handleEvents();
+        }
+
+        if (inputSink != nullptr) {
+            inputSink->submit();
+        }
+    }
+}
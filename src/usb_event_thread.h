@@ -0,0 +1,78 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef USERSPACE_TABLET_DRIVER_DAEMON_USB_EVENT_THREAD_H
+#define USERSPACE_TABLET_DRIVER_DAEMON_USB_EVENT_THREAD_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "event_reactor.h"
+#include "spsc_queue.h"
+#include "usb_devices.h"
+#include "input_sink.h"
+
+// The thread that services libusb and therefore every transfer callback and uinput write. Nothing else runs here
+// except commands handed over by the control thread, so a slow socket client, config reload or device claim retry
+// can never hold up pen input.
+class usb_event_thread {
+public:
+    typedef std::function<void()> command;
+
+    usb_event_thread();
+    ~usb_event_thread();
+
+    // priority 0 keeps the default scheduler, 1-99 requests SCHED_FIFO. cpu -1 leaves the thread unpinned
+    bool start(usb_devices* devices, int priority, int cpu);
+    void stop();
+    bool isRunning();
+
+    // The sink is given a chance to push out queued frames after every batch of transfers
+    void setInputSink(input_sink* sink);
+
+    // Queues a command to run on the usb thread and returns immediately. Must only be called from the control thread.
+    void post(command cmd);
+
+    // Runs a command on the usb thread and waits for it to finish. Runs it directly if called on the usb thread or
+    // while the thread isn't running.
+    void invoke(command cmd);
+
+    // Lets libusb complete transfers for up to timeoutMs. Only for commands already running on the usb thread.
+    void serviceEvents(int timeoutMs);
+
+private:
+    void run();
+    void applyScheduling();
+    void drainCommands();
+
+    usb_devices* devices;
+    input_sink* inputSink;
+    event_reactor reactor;
+    int commandFd;
+    spsc_queue<command, 64> commands;
+
+    std::thread thread;
+    std::thread::id threadId;
+    std::atomic<bool> running;
+
+    int priority;
+    int cpu;
+};
+
+
+#endif //USERSPACE_TABLET_DRIVER_DAEMON_USB_EVENT_THREAD_H
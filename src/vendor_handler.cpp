@@ -16,21 +16,126 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <iostream>
 #include "vendor_handler.h"
-#include "transfer_handler_pair.h"
+#include "transfer_ring.h"
+#include "control_transfer.h"
+#include "usb_event_thread.h"
+
+vendor_handler::vendor_handler() {
+    usbThread = nullptr;
+    reactor = nullptr;
+    capture = nullptr;
+    inputSink = nullptr;
+    devicePool = nullptr;
+    nextAttachId = 0;
+    transfersPerEndpoint = 4;
+}
 
 vendor_handler::~vendor_handler() {
+    for (auto deviceInterface : deviceInterfaces) {
+        releaseTransfers(deviceInterface->deviceHandle);
+    }
+
+    for (auto attach : pendingAttaches) {
+        resetAttach(attach.second);
+        libusb_unref_device(attach.second->device);
+        delete attach.second;
+    }
+
     for (auto deviceInterface : deviceInterfaces) {
         cleanupDevice(deviceInterface);
     }
+
+    reapTransferRings();
 }
 
 void vendor_handler::setMessageQueue(unix_socket_message_queue *queue) {
     messageQueue = queue;
 }
 
-bool vendor_handler::setupReportProtocol(libusb_device_handle* handle, unsigned char interface_number) {
+std::vector<latency_summary> vendor_handler::getLatencySummaries() {
+    std::vector<latency_summary> summaries;
+
+    for (auto deviceInterface : deviceInterfaces) {
+        auto handler = productHandlers.find(deviceInterface->productId);
+        if (handler == productHandlers.end()) {
+            continue;
+        }
+
+        device_context* context = handler->second->findDeviceContext(deviceInterface->deviceHandle);
+        if (context == nullptr) {
+            continue;
+        }
+
+        latency_summary summary {};
+        summary.vendorId = getVendorId();
+        summary.productId = deviceInterface->productId;
+        summary.count = context->latency.getCount();
+        summary.p50 = context->latency.getPercentile(0.5);
+        summary.p99 = context->latency.getPercentile(0.99);
+        summary.p999 = context->latency.getPercentile(0.999);
+        summary.max = context->latency.getMax();
+        summaries.push_back(summary);
+    }
+
+    return summaries;
+}
+
+void vendor_handler::setTransfersPerEndpoint(int count) {
+    transfersPerEndpoint = count > 0 ? count : 1;
+}
+
+void vendor_handler::setUsbThread(usb_event_thread *thread) {
+    usbThread = thread;
+}
+
+void vendor_handler::setReactor(event_reactor *eventReactor) {
+    reactor = eventReactor;
+}
+
+void vendor_handler::setCapture(report_capture *reportCapture) {
+    capture = reportCapture;
+}
+
+void vendor_handler::setInputSink(input_sink *sink) {
+    inputSink = sink;
+    for (auto handler : productHandlers) {
+        handler.second->setInputSink(sink);
+    }
+}
+
+void vendor_handler::setDevicePool(uinput_device_pool *pool) {
+    devicePool = pool;
+    for (auto handler : productHandlers) {
+        handler.second->setDevicePool(pool);
+    }
+}
+
+transfer_handler* vendor_handler::getProductHandler(int productId) {
+    auto handler = productHandlers.find(productId);
+    if (handler == productHandlers.end()) {
+        return nullptr;
+    }
+
+    return handler->second;
+}
+
+void vendor_handler::runOnUsbThread(std::function<void()> command) {
+    if (usbThread != nullptr) {
+        usbThread->invoke(command);
+    } else {
+        command();
+    }
+}
+
+bool vendor_handler::setupReportProtocol(libusb_device_handle* handle, unsigned char interface_number, probe_record* probe) {
+    // A device that stalled this before will stall it again
+    if (probe != nullptr && probe->reportProtocolUnsupported.count(interface_number) != 0) {
+        return true;
+    }
+
     int err = libusb_control_transfer(handle,
                                   0x21,
                                   0x0b,
@@ -43,10 +148,18 @@ bool vendor_handler::setupReportProtocol(libusb_device_handle* handle, unsigned
         return false;
     }
 
+    if (err == LIBUSB_ERROR_PIPE && probe != nullptr) {
+        probe->reportProtocolUnsupported.insert(interface_number);
+    }
+
     return true;
 }
 
-bool vendor_handler::setupInfiniteIdle(libusb_device_handle* handle, unsigned char interface_number) {
+bool vendor_handler::setupInfiniteIdle(libusb_device_handle* handle, unsigned char interface_number, probe_record* probe) {
+    if (probe != nullptr && probe->infiniteIdleUnsupported.count(interface_number) != 0) {
+        return true;
+    }
+
     int err = libusb_control_transfer(handle,
                                   0x21,
                                   0x0a,
@@ -60,6 +173,10 @@ bool vendor_handler::setupInfiniteIdle(libusb_device_handle* handle, unsigned ch
         return false;
     }
 
+    if (err == LIBUSB_ERROR_PIPE && probe != nullptr) {
+        probe->infiniteIdleUnsupported.insert(interface_number);
+    }
+
     return true;
 }
 
@@ -74,194 +191,501 @@ void vendor_handler::cleanupDevice(device_interface_pair *pair) {
 }
 
 void vendor_handler::addHandler(transfer_handler *handler) {
+    if (inputSink != nullptr) {
+        handler->setInputSink(inputSink);
+    }
+
+    if (devicePool != nullptr) {
+        handler->setDevicePool(devicePool);
+    }
+
     for (auto productId : handler->handledProductIds()) {
         productHandlers[productId] = handler;
         handledProducts.push_back(productId);
     }
 }
 
-device_interface_pair* vendor_handler::claimDevice(libusb_device *device, libusb_device_handle *handle, const libusb_device_descriptor descriptor) {
-    device_interface_pair* deviceInterface = new device_interface_pair();
-    int err;
+bool vendor_handler::beginAttach(libusb_device *device, const libusb_device_descriptor descriptor) {
+    if (pendingAttaches.find(device) != pendingAttaches.end() || deviceInterfaceMap.find(device) != deviceInterfaceMap.end()) {
+        return true;
+    }
+
+    // Hold on to the device for as long as the attach is in progress
+    libusb_ref_device(device);
+
+    device_attach* attach = new device_attach();
+    attach->id = nextAttachId++;
+    attach->device = device;
+    attach->descriptor = descriptor;
+    attach->configDescriptor = nullptr;
+    attach->interfacePair = nullptr;
+    attach->stage = device_attach_stage::probe;
+    attach->productId = descriptor.idProduct;
+    attach->attempt = 0;
+    attach->probe = nullptr;
+
+    pendingAttaches[device] = attach;
+    scheduleAttachStage(attach, 0);
+
+    return true;
+}
+
+void vendor_handler::cancelAttach(libusb_device *device) {
+    auto record = pendingAttaches.find(device);
+    if (record == pendingAttaches.end()) {
+        return;
+    }
+
+    device_attach* attach = record->second;
+    pendingAttaches.erase(record);
+
+    runOnUsbThread([this, attach]() {
+        resetAttach(attach);
+    });
+    libusb_unref_device(attach->device);
+    delete attach;
+}
+
+void vendor_handler::scheduleAttachStage(device_attach *attach, int delayMs) {
+    libusb_device* device = attach->device;
+    unsigned long attachId = attach->id;
+
+    if (reactor == nullptr || !reactor->addTimer(delayMs, [this, device, attachId]() {
+        advanceAttach(device, attachId);
+    })) {
+        advanceAttach(device, attachId);
+    }
+}
+
+void vendor_handler::advanceAttach(libusb_device *device, unsigned long attachId) {
+    const int maxRetries = 5;
+
+    // The device may have gone away, or gone away and come back, since this stage was scheduled
+    auto record = pendingAttaches.find(device);
+    if (record == pendingAttaches.end() || record->second->id != attachId) {
+        return;
+    }
+
+    device_attach* attach = record->second;
+    bool succeeded = false;
+    runOnUsbThread([this, attach, &succeeded]() {
+        succeeded = runAttachStage(attach);
+    });
+
+    if (succeeded) {
+        attach->stage = (device_attach_stage)(attach->stage + 1);
+        if (attach->stage == device_attach_stage::attached) {
+            finishAttach(attach);
+        } else {
+            scheduleAttachStage(attach, 0);
+        }
+
+        return;
+    }
+
+    runOnUsbThread([this, attach]() {
+        resetAttach(attach);
+    });
+
+    ++attach->attempt;
+    if (attach->attempt >= maxRetries) {
+        std::cout << "Giving up" << std::endl;
+        pendingAttaches.erase(device);
+        libusb_unref_device(attach->device);
+        delete attach;
+        return;
+    }
+
+    std::cout << "Could not claim device on attempt " << attach->attempt << ". Detaching and then waiting" << std::endl;
+    scheduleAttachStage(attach, 1000);
+}
+
+bool vendor_handler::runAttachStage(device_attach *attach) {
+    switch (attach->stage) {
+        case device_attach_stage::probe:
+            return probeDevice(attach);
+
+        case device_attach_stage::detachKernelDriver:
+            return detachKernelDrivers(attach);
+
+        case device_attach_stage::claim:
+            return claimInterfaces(attach);
+
+        case device_attach_stage::queryDescriptors:
+            return queryDeviceDescriptors(attach);
 
-    struct libusb_config_descriptor* configDescriptor;
-    err = libusb_get_config_descriptor(device, 0, &configDescriptor);
+        case device_attach_stage::createUinput:
+            return createUinputDevices(attach);
+
+        case device_attach_stage::submitTransfers:
+            return submitDeviceTransfers(attach);
+
+        default:
+            return false;
+    }
+}
+
+void vendor_handler::resetAttach(device_attach *attach) {
+    if (attach->interfacePair != nullptr) {
+        releaseTransfers(attach->interfacePair->deviceHandle);
+
+        auto handler = productHandlers.find(attach->productId);
+        if (handler != productHandlers.end()) {
+            handler->second->detachDevice(attach->interfacePair->deviceHandle);
+        }
+
+        cleanupDevice(attach->interfacePair);
+        libusb_close(attach->interfacePair->deviceHandle);
+        delete attach->interfacePair;
+        attach->interfacePair = nullptr;
+    }
+
+    if (attach->configDescriptor != nullptr) {
+        libusb_free_config_descriptor(attach->configDescriptor);
+        attach->configDescriptor = nullptr;
+    }
+
+    attach->stage = device_attach_stage::probe;
+    attach->productId = attach->descriptor.idProduct;
+    attach->configuredInterfaces.clear();
+}
+
+void vendor_handler::finishAttach(device_attach *attach) {
+    deviceInterfaces.push_back(attach->interfacePair);
+    deviceInterfaceMap[attach->device] = attach->interfacePair;
+
+    libusb_free_config_descriptor(attach->configDescriptor);
+    pendingAttaches.erase(attach->device);
+    libusb_unref_device(attach->device);
+    delete attach;
+}
+
+bool vendor_handler::probeDevice(device_attach *attach) {
+    int err = libusb_get_config_descriptor(attach->device, 0, &attach->configDescriptor);
     if (err != LIBUSB_SUCCESS) {
         std::cout << "Could not get config descriptor" << std::endl;
+        attach->configDescriptor = nullptr;
+        return false;
     }
 
-    auto productId = descriptor.idProduct;
-    bool checkedForAliasing = false;
+    libusb_device_handle* handle = NULL;
+    if ((err = libusb_open(attach->device, &handle)) != LIBUSB_SUCCESS) {
+        std::cout << "libusb_open returned error " << err << std::endl;
+        if (err == LIBUSB_ERROR_ACCESS) {
+            std::cout << "This was an access denied error. Is the correct udev rule set up?" << std::endl;
+        }
+        return false;
+    }
 
-    if ((err = libusb_open(device, &handle)) == LIBUSB_SUCCESS) {
-        deviceInterface->deviceHandle = handle;
-        unsigned char interfaceCount = configDescriptor->bNumInterfaces;
+    attach->interfacePair = new device_interface_pair();
+    attach->interfacePair->deviceHandle = handle;
+    attach->interfacePair->productId = attach->productId;
 
-        for (unsigned char interface_number = 0; interface_number < interfaceCount; ++interface_number) {
-            // Skip interfaces with more than 1 alt setting
-            if (configDescriptor->interface[interface_number].num_altsetting != 1) {
-                continue;
-            }
+    attach->probe = probeCache.getRecord(attach->device, attach->descriptor);
 
-            if (libusb_kernel_driver_active(handle, interface_number)) {
-                err = libusb_detach_kernel_driver(handle, interface_number);
-                if (LIBUSB_SUCCESS == err) {
-                    deviceInterface->detachedInterfaces.push_back(interface_number);
-                } else {
-                    std::cout << "Got " << err << " when detaching kernel driver" << std::endl;
-                }
-            }
+    return true;
+}
+
+bool vendor_handler::detachKernelDrivers(device_attach *attach) {
+    libusb_device_handle* handle = attach->interfacePair->deviceHandle;
+    unsigned char interfaceCount = attach->configDescriptor->bNumInterfaces;
+
+    for (unsigned char interface_number = 0; interface_number < interfaceCount; ++interface_number) {
+        // Skip interfaces with more than 1 alt setting
+        if (attach->configDescriptor->interface[interface_number].num_altsetting != 1) {
+            continue;
+        }
 
-            err = libusb_claim_interface(handle, interface_number);
+        if (libusb_kernel_driver_active(handle, interface_number)) {
+            int err = libusb_detach_kernel_driver(handle, interface_number);
             if (LIBUSB_SUCCESS == err) {
-                deviceInterface->claimedInterfaces.push_back(interface_number);
+                attach->interfacePair->detachedInterfaces.push_back(interface_number);
+            } else {
+                std::cout << "Got " << err << " when detaching kernel driver" << std::endl;
+            }
+        }
+    }
 
-                // Here we replace our product ID with an aliased one if necessary
-                if (!checkedForAliasing) {
-                    productId = productHandlers[descriptor.idProduct]->getAliasedProductId(handle,
-                                                                                           descriptor.idProduct);
-                    checkedForAliasing = true;
-                }
+    return true;
+}
 
-                // Even though we claim the interface, we only actually care about specific ones. We still do
-                // the claim so that no other driver mangles events while we are handling it
-                if (productHandlers[productId]->attachToInterfaceId(interface_number)) {
-                    // Attach to our handler
-                    if (!productHandlers[productId]->attachDevice(handle, interface_number, productId)) {
-                        delete deviceInterface;
-                        return nullptr;
-                    }
+bool vendor_handler::claimInterfaces(device_attach *attach) {
+    libusb_device_handle* handle = attach->interfacePair->deviceHandle;
+    unsigned char interfaceCount = attach->configDescriptor->bNumInterfaces;
 
-                    std::cout << "Attached to interface " << (int)interface_number << std::endl;
-                }
+    for (unsigned char interface_number = 0; interface_number < interfaceCount; ++interface_number) {
+        if (attach->configDescriptor->interface[interface_number].num_altsetting != 1) {
+            continue;
+        }
 
-                const libusb_interface_descriptor *interfaceDescriptor =
-                        configDescriptor->interface[interface_number].altsetting;
+        // Even though we claim every interface, we only actually care about specific ones. We still do the claim so
+        // that no other driver mangles events while we are handling it
+        int err = libusb_claim_interface(handle, interface_number);
+        if (LIBUSB_SUCCESS != err) {
+            std::cout << "Could not claim interface " << (int)interface_number << " retcode: " << err << " errno: " << errno << std::endl;
+            return false;
+        }
 
-                if (!setupReportProtocol(handle, interface_number) ||
-                    !setupInfiniteIdle(handle, interface_number)) {
-                    continue;
-                }
+        attach->interfacePair->claimedInterfaces.push_back(interface_number);
+    }
 
-                const libusb_endpoint_descriptor *endpoint = interfaceDescriptor->endpoint;
-                const libusb_endpoint_descriptor *ep;
-                for (ep = endpoint; (ep - endpoint) < interfaceDescriptor->bNumEndpoints; ++ep) {
-                    // Ignore any interface that isn't of an interrupt type
-                    if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_INTERRUPT)
-                        continue;
-
-                    // We only send the init key on the interface the handler says it should be on
-                    if (productHandlers[productId]->sendInitKeyOnInterface() == interface_number) {
-                        if ((ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_OUT) {
-                            sendInitKey(handle, ep->bEndpointAddress, productHandlers[productId]);
-                        }
-                    }
-
-                    if ((ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
-                        struct transfer_setup_data setupData {
-                                handle,
-                                ep->bEndpointAddress,
-                                ep->wMaxPacketSize,
-                                productId
-                        };
-                        transfersSetUp.push_back(setupData);
-                        setupTransfers(handle, ep->bEndpointAddress, ep->wMaxPacketSize, productId);
-                    }
-                }
+    return true;
+}
 
-                // Have the device set up any offset pressure values
-                productHandlers[productId]->setOffsetPressure(productId);
+bool vendor_handler::queryDeviceDescriptors(device_attach *attach) {
+    libusb_device_handle* handle = attach->interfacePair->deviceHandle;
 
-                std::cout << std::dec << "Setup completed on interface " << (int)interface_number << std::endl;
-            } else {
-                std::cout << "Could not claim interface " << (int)interface_number << " retcode: " << err << " errno: " << errno << std::endl;
-                delete deviceInterface;
-                return nullptr;
+    // Lets the handlers answer descriptor reads from an earlier attach on the same port
+    auto physicalHandler = productHandlers[attach->descriptor.idProduct];
+    physicalHandler->getDeviceContext(handle)->probe = attach->probe;
+
+    // Here we replace our product ID with an aliased one if necessary
+    if (!attach->interfacePair->claimedInterfaces.empty()) {
+        attach->productId = physicalHandler->getAliasedProductId(handle, attach->descriptor.idProduct);
+        attach->interfacePair->productId = attach->productId;
+
+        // Whatever the physical handler learnt while aliasing, like the firmware name, goes with the device
+        auto aliasedHandler = productHandlers.find(attach->productId);
+        if (aliasedHandler != productHandlers.end() && aliasedHandler->second != physicalHandler) {
+            auto context = physicalHandler->releaseDeviceContext(handle);
+            if (context != nullptr) {
+                aliasedHandler->second->adoptDeviceContext(context);
             }
         }
-    } else {
-        std::cout << "libusb_open returned error " << err << std::endl;
-        if (err == LIBUSB_ERROR_ACCESS) {
-            std::cout << "This was an access denied error. Is the correct udev rule set up?" << std::endl;
+    }
+
+    for (auto interface_number : attach->interfacePair->claimedInterfaces) {
+        if (setupReportProtocol(handle, interface_number, attach->probe) &&
+            setupInfiniteIdle(handle, interface_number, attach->probe)) {
+            attach->configuredInterfaces.push_back(interface_number);
+        }
+    }
+
+    return true;
+}
+
+bool vendor_handler::createUinputDevices(device_attach *attach) {
+    libusb_device_handle* handle = attach->interfacePair->deviceHandle;
+    auto productHandler = productHandlers[attach->productId];
+
+    for (auto interface_number : attach->interfacePair->claimedInterfaces) {
+        if (productHandler->attachToInterfaceId(interface_number)) {
+            // Attach to our handler
+            if (!productHandler->attachDevice(handle, interface_number, attach->productId)) {
+                return false;
+            }
+
+            std::cout << "Attached to interface " << (int)interface_number << std::endl;
         }
-        delete deviceInterface;
-        return nullptr;
     }
 
-    deviceInterface->productId = productId;
+    return true;
+}
+
+bool vendor_handler::submitDeviceTransfers(device_attach *attach) {
+    libusb_device_handle* handle = attach->interfacePair->deviceHandle;
+    int productId = attach->productId;
+    auto productHandler = productHandlers[productId];
+
+    for (auto interface_number : attach->configuredInterfaces) {
+        const libusb_interface_descriptor *interfaceDescriptor =
+                attach->configDescriptor->interface[interface_number].altsetting;
+
+        const libusb_endpoint_descriptor *endpoint = interfaceDescriptor->endpoint;
+        const libusb_endpoint_descriptor *ep;
+        for (ep = endpoint; (ep - endpoint) < interfaceDescriptor->bNumEndpoints; ++ep) {
+            // Ignore any interface that isn't of an interrupt type
+            if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_INTERRUPT)
+                continue;
+
+            // We only send the init key on the interface the handler says it should be on
+            if (productHandler->sendInitKeyOnInterface() == interface_number) {
+                if ((ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_OUT) {
+                    sendInitKey(handle, ep->bEndpointAddress, productHandler);
+                }
+            }
+
+            if ((ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
+                setupTransfers(handle, ep->bEndpointAddress, ep->wMaxPacketSize, productId);
+            }
+        }
+
+        std::cout << std::dec << "Setup completed on interface " << (int)interface_number << std::endl;
+    }
+
+    // Have the device set up any offset pressure values
+    productHandler->setOffsetPressure(productId);
+
     auto productString = std::to_string(productId);
-    std::cout << "Set up config for device " << productString << ": (" << productHandlers[productId]->getProductName(productId) << ")" <<  std::endl;
-    productHandlers[productId]->setConfig(getConfig()[productString]);
-    return deviceInterface;
+    std::cout << "Set up config for device " << productString << ": (" << productHandler->getProductName(productId) << ")" <<  std::endl;
+    productHandler->setConfig(getConfig()[productString]);
+
+    return true;
 }
 
 bool vendor_handler::setupTransfers(libusb_device_handle *handle, unsigned char interface_number, int maxPacketSize, int productId) {
-    struct libusb_transfer* transfer = libusb_alloc_transfer(0);
-    if (transfer == NULL) {
-        std::cout << "Could not allocate a transfer for interface " << interface_number << std::endl;
+    struct transfer_handler_pair dataPair;
+    dataPair.vendorHandler = this;
+    dataPair.transferHandler = productHandlers[productId];
+    dataPair.context = dataPair.transferHandler->getDeviceContext(handle);
+    dataPair.capture = capture;
+    dataPair.productId = productId;
+
+    auto ring = new transfer_ring(dataPair, getVendorId());
+    if (!ring->submit(handle, interface_number, maxPacketSize, transfersPerEndpoint)) {
+        std::cout << "Could not submit any transfers on interface " << (int)interface_number << std::endl;
+        ring->cancel();
+        if (ring->isIdle()) {
+            delete ring;
+        } else {
+            retiredRings.push_back(ring);
+        }
         return false;
     }
 
-    transfer->user_data = NULL;
-    unsigned char* buff = new unsigned char[maxPacketSize];
+    transferRings.push_back(ring);
 
-    struct transfer_handler_pair* dataPair = new transfer_handler_pair();
-    dataPair->vendorHandler = this;
-    dataPair->transferHandler = productHandlers[productId];
-    dataPair->productId = productId;
+    return true;
+}
 
-    libusb_fill_interrupt_transfer(transfer,
-                                   handle, interface_number | LIBUSB_ENDPOINT_IN,
-                                   buff, maxPacketSize,
-                                   transferCallback, dataPair,
-                                   60000);
+void vendor_handler::releaseTransfers(libusb_device_handle *handle) {
+    std::vector<transfer_ring*> releasedRings;
+    for (auto ring = transferRings.begin(); ring != transferRings.end();) {
+        if ((*ring)->getHandle() == handle) {
+            (*ring)->cancel();
+            releasedRings.push_back(*ring);
+            ring = transferRings.erase(ring);
+        } else {
+            ++ring;
+        }
+    }
 
-    transfer->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
-    int ret = libusb_submit_transfer(transfer);
-    if (ret != LIBUSB_SUCCESS) {
-        std::cout << "Could not submit transfer on interface " << (int)interface_number << " ret: " << ret << " errno: " << errno << std::endl;
-        return false;
+    // Copied since cancelling a request that is only waiting on a ring finishes it straight away
+    auto controls = controlTransfers;
+    for (auto control : controls) {
+        if (control->getHandle() == handle) {
+            control->cancel();
+        }
     }
 
-    libusbTransfers.push_back(transfer);
+    if (releasedRings.empty() && !hasControlTransfers(handle)) {
+        return;
+    }
 
-    return true;
+    // libusb still owns the transfers until their cancellation has come back through the event loop
+    if (!waitForTransfers(releasedRings, handle)) {
+        std::cout << "Transfers of a released device are still in flight" << std::endl;
+    }
+
+    for (auto ring : releasedRings) {
+        if (ring->isIdle()) {
+            delete ring;
+        } else {
+            retiredRings.push_back(ring);
+        }
+    }
+
+    reapTransferRings();
 }
 
-void vendor_handler::transferCallback(struct libusb_transfer *transfer) {
-    int err;
-    struct transfer_handler_pair* dataPair = (transfer_handler_pair*)transfer->user_data;
+bool vendor_handler::waitForTransfers(const std::vector<transfer_ring*>& rings, libusb_device_handle* handle) {
+    const int stepMs = 10;
+    const int maxWaitMs = 1000;
 
-    switch (transfer->status) {
-        case LIBUSB_TRANSFER_COMPLETED:
-            // Send the packet data to the registered handler
-            dataPair->transferHandler->handleTransferData(transfer->dev_handle, transfer->buffer, transfer->actual_length, dataPair->productId);
+    for (int waitedMs = 0; ; waitedMs += stepMs) {
+        bool idle = !hasControlTransfers(handle);
+        for (auto ring : rings) {
+            idle = idle && ring->isIdle();
+        }
 
-            // Resubmit the transfer
-            err = libusb_submit_transfer(transfer);
-            if (err != LIBUSB_SUCCESS) {
-                std::cout << "Could not resubmit my transfer" << std::endl;
-            }
+        if (idle) {
+            return true;
+        }
 
-            break;
+        if (usbThread == nullptr || waitedMs >= maxWaitMs) {
+            return false;
+        }
 
-        case LIBUSB_TRANSFER_TIMED_OUT:
-            // Resubmit the transfer
-            err = libusb_submit_transfer(transfer);
-            if (err != LIBUSB_SUCCESS) {
-                std::cout << "Could not resubmit my transfer" << std::endl;
-            }
+        usbThread->serviceEvents(stepMs);
+    }
+}
+
+void vendor_handler::reapTransferRings() {
+    for (auto ring = retiredRings.begin(); ring != retiredRings.end();) {
+        if ((*ring)->isIdle()) {
+            delete *ring;
+            ring = retiredRings.erase(ring);
+        } else {
+            ++ring;
+        }
+    }
+}
 
-            break;
+bool vendor_handler::submitControlTransfer(libusb_device_handle *handle, unix_socket_message *message) {
+    const int controlTimeoutMs = 2500;
 
-        case LIBUSB_TRANSFER_CANCELLED:
-            break;
+    auto control = new control_transfer(this, handle, message);
+    if (!control->submit()) {
+        delete control;
+        return false;
+    }
 
-        case LIBUSB_TRANSFER_NO_DEVICE:
-            break;
+    controlTransfers.push_back(control);
 
-        default:
-            std::cout << "Unknown status received " << transfer->status << std::endl;
-            break;
+    // libusb times out our own transfers but a response expected from a ring could otherwise wait forever
+    unsigned long requestId = message->requestId;
+    if (reactor != nullptr) {
+        reactor->addTimer(controlTimeoutMs, [this, requestId]() {
+            runOnUsbThread([this, requestId]() {
+                expireControlTransfers(requestId);
+            });
+        });
+    }
+
+    return true;
+}
+
+bool vendor_handler::awaitControlResponse(control_transfer *control) {
+    for (auto ring : transferRings) {
+        if (ring->getHandle() == control->getHandle() && ring->getEndpoint() == control->getResponseEndpoint()) {
+            ring->addResponseWaiter(control);
+            return true;
+        }
     }
+
+    return control->receive();
+}
+
+void vendor_handler::finishControlTransfer(control_transfer *control) {
+    for (auto ring : transferRings) {
+        ring->removeResponseWaiter(control);
+    }
+
+    auto record = std::find(controlTransfers.begin(), controlTransfers.end(), control);
+    if (record != controlTransfers.end()) {
+        controlTransfers.erase(record);
+    }
+
+    messageQueue->addMessage(control->createResponse(messageQueue));
+    delete control;
+}
+
+void vendor_handler::expireControlTransfers(unsigned long requestId) {
+    auto controls = controlTransfers;
+    for (auto control : controls) {
+        if (control->getRequestId() == requestId) {
+            std::cout << "Message " << requestId << " timed out" << std::endl;
+            control->cancel();
+        }
+    }
+}
+
+bool vendor_handler::hasControlTransfers(libusb_device_handle *handle) {
+    for (auto control : controlTransfers) {
+        if (control->getHandle() == handle) {
+            return true;
+        }
+    }
+
+    return false;
 }
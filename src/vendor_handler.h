@@ -21,15 +21,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <functional>
 #include <libusb-1.0/libusb.h>
 #include "includes/json.hpp"
 #include "unix_socket_message_queue.h"
 #include "device_interface_pair.h"
 #include "transfer_handler.h"
-#include "transfer_setup_data.h"
+#include "device_attach.h"
+#include "event_reactor.h"
+#include "latency_histogram.h"
+#include "report_capture.h"
+#include "input_sink.h"
+#include "probe_cache.h"
+
+class transfer_ring;
+class control_transfer;
+class usb_event_thread;
 
 class vendor_handler {
 public:
+    vendor_handler();
     virtual ~vendor_handler();
 
     virtual int getVendorId() { return 0x0000; };
@@ -38,35 +50,88 @@ public:
     virtual void setConfig(nlohmann::json config) {};
     virtual nlohmann::json getConfig() { return nlohmann::json({}); };
     virtual void setMessageQueue(unix_socket_message_queue* queue);
+    virtual void setTransfersPerEndpoint(int count);
+    virtual void setUsbThread(usb_event_thread* thread);
+    virtual void setReactor(event_reactor* reactor);
+    virtual void setCapture(report_capture* capture);
+    virtual void setInputSink(input_sink* sink);
+    virtual void setDevicePool(uinput_device_pool* pool);
+    // The handler for a (possibly aliased) product id or nullptr if we don't handle it
+    transfer_handler* getProductHandler(int productId);
     virtual void handleMessages() { };
     virtual std::set<short> getConnectedDevices() { return std::set<short>(); }
+    virtual std::vector<latency_summary> getLatencySummaries();
     virtual bool handleProductAttach(libusb_device* device, const struct libusb_device_descriptor descriptor) { return false; };
     virtual void handleProductDetach(libusb_device* device, const struct libusb_device_descriptor descriptor) {};
 
     virtual void sendInitKey(libusb_device_handle* handle, int interface_number, transfer_handler* productHandler) {}
+
+    // Called by control transfers on the usb thread once their request went out and once they are done
+    bool awaitControlResponse(control_transfer* control);
+    void finishControlTransfer(control_transfer* control);
 protected:
-    virtual bool setupReportProtocol(libusb_device_handle* handle, unsigned char interface_number);
-    virtual bool setupInfiniteIdle(libusb_device_handle* handle, unsigned char interface_number);
+    virtual bool setupReportProtocol(libusb_device_handle* handle, unsigned char interface_number, probe_record* probe);
+    virtual bool setupInfiniteIdle(libusb_device_handle* handle, unsigned char interface_number, probe_record* probe);
 
     virtual void addHandler(transfer_handler*);
 
     virtual void cleanupDevice(device_interface_pair* pair);
-    virtual device_interface_pair* claimDevice(libusb_device* device, libusb_device_handle* handle, const libusb_device_descriptor descriptor);
+
+    // Starts attaching a device in the background. Each stage runs on the usb thread on its own turn of the control
+    // loop and failures are retried from a timer, so a misbehaving device never holds up the others
+    virtual bool beginAttach(libusb_device* device, const libusb_device_descriptor descriptor);
+    virtual void cancelAttach(libusb_device* device);
+
+    void scheduleAttachStage(device_attach* attach, int delayMs);
+    void advanceAttach(libusb_device* device, unsigned long attachId);
+    bool runAttachStage(device_attach* attach);
+    void resetAttach(device_attach* attach);
+    void finishAttach(device_attach* attach);
+
+    bool probeDevice(device_attach* attach);
+    bool detachKernelDrivers(device_attach* attach);
+    bool claimInterfaces(device_attach* attach);
+    bool queryDeviceDescriptors(device_attach* attach);
+    bool createUinputDevices(device_attach* attach);
+    bool submitDeviceTransfers(device_attach* attach);
 
     virtual bool setupTransfers(libusb_device_handle* handle, unsigned char interface_number, int maxPacketSize, int productId);
-    static void LIBUSB_CALL transferCallback(struct libusb_transfer* transfer);
+    // Must be called before the handle of a device is closed
+    void releaseTransfers(libusb_device_handle* handle);
+    bool waitForTransfers(const std::vector<transfer_ring*>& rings, libusb_device_handle* handle);
+    void reapTransferRings();
+
+    // Sends a GUI message to one device without holding up its reports. Runs on the usb thread.
+    bool submitControlTransfer(libusb_device_handle* handle, unix_socket_message* message);
+    void expireControlTransfers(unsigned long requestId);
+    bool hasControlTransfers(libusb_device_handle* handle);
+
+    // Anything that touches a device the usb thread may be servicing has to go through here
+    void runOnUsbThread(std::function<void()> command);
 
     unix_socket_message_queue* messageQueue;
+    usb_event_thread* usbThread;
+    event_reactor* reactor;
+    report_capture* capture;
+    input_sink* inputSink;
+    uinput_device_pool* devicePool;
+
+    std::map<libusb_device*, device_attach*> pendingAttaches;
+    probe_cache probeCache;
+    unsigned long nextAttachId;
 
     std::map<libusb_device*, device_interface_pair*> deviceInterfaceMap;
     std::vector<device_interface_pair*> deviceInterfaces;
-    std::map<int, transfer_handler*> productHandlers;
+    std::unordered_map<int, transfer_handler*> productHandlers;
 
     std::vector<int> handledProducts;
     nlohmann::json jsonConfig;
 
-    std::vector<transfer_setup_data> transfersSetUp;
-    std::vector<libusb_transfer*> libusbTransfers;
+    std::vector<transfer_ring*> transferRings;
+    // Rings whose transfers libusb had not handed back when their device went away
+    std::vector<transfer_ring*> retiredRings;
+    std::vector<control_transfer*> controlTransfers;
+    int transfersPerEndpoint;
 };
 
 #endif //USERSPACE_TABLET_DRIVER_DAEMON_VENDOR_HANDLER_H
@@ -18,7 +18,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <algorithm>
-#include <thread>
 #include <set>
 #include "xp_pen_handler.h"
 #include "artist_22r_pro.h"
@@ -45,31 +44,77 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "deco_02.h"
 #include "deco_large.h"
 
-xp_pen_handler::xp_pen_handler() {
+typedef transfer_handler* (*xp_pen_driver_factory)();
+
+// The protocol code behind each driver name used in the device database
+static const std::vector<std::pair<std::string, xp_pen_driver_factory>> xpPenDrivers = {
+        {"artist_22r_pro", []() -> transfer_handler* { return new artist_22r_pro(); }},
+        {"artist_22e_pro", []() -> transfer_handler* { return new artist_22e_pro(); }},
+        {"artist_16_pro", []() -> transfer_handler* { return new artist_16_pro(); }},
+        {"artist_pro_16tp", []() -> transfer_handler* { return new artist_pro_16tp(); }},
+        {"artist_pro_16", []() -> transfer_handler* { return new artist_pro_16(); }},
+        {"artist_13_3_pro", []() -> transfer_handler* { return new artist_13_3_pro(); }},
+        {"artist_15_6_pro", []() -> transfer_handler* { return new artist_15_6_pro(); }},
+        {"artist_24_pro", []() -> transfer_handler* { return new artist_24_pro(); }},
+        {"artist_12_pro", []() -> transfer_handler* { return new artist_12_pro(); }},
+        {"artist_12", []() -> transfer_handler* { return new artist_12(); }},
+        {"innovator_16", []() -> transfer_handler* { return new innovator_16(); }},
+        {"deco_pro_small", []() -> transfer_handler* { return new deco_pro_small(); }},
+        {"deco_pro_medium", []() -> transfer_handler* { return new deco_pro_medium(); }},
+        {"deco_pro_medium_wireless", []() -> transfer_handler* { return new deco_pro_medium_wireless(); }},
+        {"deco_01v2", []() -> transfer_handler* { return new deco_01v2(); }},
+        {"deco_03", []() -> transfer_handler* { return new deco_03(); }},
+        {"deco_mini7", []() -> transfer_handler* { return new deco_mini7(); }},
+        {"star_g430s", []() -> transfer_handler* { return new star_g430s(); }},
+        {"star_g640", []() -> transfer_handler* { return new star_g640(); }},
+        {"ac19", []() -> transfer_handler* { return new ac19(); }},
+        {"deco_02", []() -> transfer_handler* { return new deco_02(); }},
+        {"deco_large", []() -> transfer_handler* { return new deco_large(); }},
+};
+
+xp_pen_handler::xp_pen_handler(const device_database& database) {
     std::cout << "xp_pen_handler initialized" << std::endl;
 
-    addHandler(new artist_22r_pro());
-    addHandler(new artist_22e_pro());
-    addHandler(new artist_16_pro());
-	addHandler(new artist_pro_16tp());
-    addHandler(new artist_pro_16());
-    addHandler(new artist_13_3_pro());
-    addHandler(new artist_15_6_pro());
-    addHandler(new artist_24_pro());
-    addHandler(new artist_12_pro());
-    addHandler(new artist_12());
-    addHandler(new innovator_16());
-    addHandler(new deco_pro_small());
-    addHandler(new deco_pro_medium());
-    addHandler(new deco_pro_medium_wireless());
-    addHandler(new deco_01v2());
-    addHandler(new deco_03());
-    addHandler(new deco_mini7());
-    addHandler(new star_g430s());
-    addHandler(new star_g640());
-    addHandler(new ac19());
-    addHandler(new deco_02());
-    addHandler(new deco_large());
+    auto entries = database.getVendorEntries(getVendorId());
+    if (entries.empty()) {
+        std::cout << "No XP-Pen devices in the device database, using the built in product list" << std::endl;
+        for (auto& driver : xpPenDrivers) {
+            addHandler(driver.second());
+        }
+
+        return;
+    }
+
+    // One handler per driver, answering for every product id the database assigns to it
+    std::vector<transfer_handler*> handlers;
+    std::map<std::string, transfer_handler*> handlersByDriver;
+    for (auto entry : entries) {
+        if (entry->driver == "generic") {
+            handlers.push_back(new generic_xp_pen_device(entry->spec));
+            continue;
+        }
+
+        auto handler = handlersByDriver.find(entry->driver);
+        if (handler == handlersByDriver.end()) {
+            auto driver = std::find_if(xpPenDrivers.begin(), xpPenDrivers.end(), [entry](const std::pair<std::string, xp_pen_driver_factory>& driver) {
+                return driver.first == entry->driver;
+            });
+
+            if (driver == xpPenDrivers.end()) {
+                std::cout << "Unknown driver " << entry->driver << " for " << entry->name << std::endl;
+                continue;
+            }
+
+            handler = handlersByDriver.insert(std::make_pair(entry->driver, driver->second())).first;
+            handlers.push_back(handler->second);
+        }
+
+        handler->second->addProduct(entry->productId, entry->name);
+    }
+
+    for (auto handler : handlers) {
+        addHandler(handler);
+    }
 }
 
 int xp_pen_handler::getVendorId() {
@@ -106,35 +151,28 @@ nlohmann::json xp_pen_handler::getConfig() {
 }
 
 void xp_pen_handler::handleMessages() {
-    auto messages = messageQueue->getMessagesFor(message_destination::driver, getVendorId());
+    std::vector<unix_socket_message*> messages;
+    messageQueue->getMessagesFor(message_destination::driver, getVendorId(), messages);
     size_t handledMessages = 0;
     size_t totalMessages = messages.size();
 
     if (totalMessages > 0) {
-        // Cancel transfers first
-        for (auto transfer: libusbTransfers) {
-            libusb_cancel_transfer(transfer);
-        }
-
-        libusbTransfers.clear();
-
+        // Messages only go to the devices they are addressed to and are sent asynchronously, so every tablet keeps
+        // reporting while one of them is reconfigured. Responses are queued once the device has answered.
         for (auto message: messages) {
             auto handler = productHandlers.find(message->device);
             if (handler != productHandlers.end()) {
-                auto responses = handler->second->handleMessage(message);
-                delete message;
-
-                for (auto response: responses) {
-                    messageQueue->addMessage(response);
+                bool submitted = false;
+                for (auto handle : handler->second->getMessageTargets(message)) {
+                    submitted = submitControlTransfer(handle, message) || submitted;
                 }
 
-                handledMessages++;
+                if (submitted) {
+                    handledMessages++;
+                }
             }
-        }
 
-        // Re-enable transfers
-        for (auto setupData: transfersSetUp) {
-            setupTransfers(setupData.handle, setupData.interface_number, setupData.maxPacketSize, setupData.productId);
+            messageQueue->releaseMessage(message);
         }
 
         std::cout << "Handled " << handledMessages << " out of " << totalMessages << " messages." << std::endl;
@@ -152,58 +190,29 @@ std::set<short> xp_pen_handler::getConnectedDevices() {
 }
 
 bool xp_pen_handler::handleProductAttach(libusb_device* device, const libusb_device_descriptor descriptor) {
-    libusb_device_handle* handle = NULL;
-    device_interface_pair* interfacePair = nullptr;
-    const int maxRetries = 5;
-    int currentAttept = 0;
-
-    if (std::find(handledProducts.begin(), handledProducts.end(), descriptor.idProduct) != handledProducts.end()) {
-        std::cout << "Handling " << productHandlers[descriptor.idProduct]->getProductName(descriptor.idProduct) << std::endl;
-        while (interfacePair == nullptr  && currentAttept < maxRetries) {
-            interfacePair = claimDevice(device, handle, descriptor);
-            if (interfacePair == nullptr) {
-                std::cout << "Could not claim device on attempt " << currentAttept << ". Detaching and then waiting" << std::endl;
-                handleProductDetach(device, descriptor);
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                ++currentAttept;
-            }
-        }
-
-        if (interfacePair != nullptr) {
-            deviceInterfaces.push_back(interfacePair);
-            deviceInterfaceMap[device] = interfacePair;
-            return true;
-        }
-
-        std::cout << "Giving up" << std::endl;
-        return false;
-    } else {
+    if (productHandlers.find(descriptor.idProduct) == productHandlers.end()) {
         // We will attempt a generic handler instead
-        auto genericHandler = new generic_xp_pen_device(descriptor.idProduct);
-        addHandler(genericHandler);
-        while (interfacePair == nullptr && currentAttept < maxRetries) {
-            interfacePair = claimDevice(device, handle, descriptor);
-            if (interfacePair == nullptr) {
-                std::cout << "Could not claim device on attempt " << currentAttept << ". Detaching and then waiting" << std::endl;
-                handleProductDetach(device, descriptor);
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                ++currentAttept;
-            }
-        }
+        std::cout << "Unknown product " << descriptor.idProduct << ", attempting the generic handler" << std::endl;
+        addHandler(new generic_xp_pen_device(descriptor.idProduct));
     }
 
-    std::cout << "Unknown product " << descriptor.idProduct << std::endl;
-
-    return false;
+    std::cout << "Handling " << productHandlers[descriptor.idProduct]->getProductName(descriptor.idProduct) << std::endl;
+    return beginAttach(device, descriptor);
 }
 
 void xp_pen_handler::handleProductDetach(libusb_device *device, struct libusb_device_descriptor descriptor) {
+    cancelAttach(device);
+
     for (auto deviceObj : deviceInterfaceMap) {
         if (deviceObj.first == device) {
             std::cout << "Handling device detach" << std::endl;
 
-            if (productHandlers.find(descriptor.idProduct) != productHandlers.end()) {
-                productHandlers[descriptor.idProduct]->detachDevice(deviceObj.second->deviceHandle);
+            // The transfers have to come back from libusb before their handle is closed
+            releaseTransfers(deviceObj.second->deviceHandle);
+
+            // The device was attached to the handler of its (possibly aliased) product id
+            if (productHandlers.find(deviceObj.second->productId) != productHandlers.end()) {
+                productHandlers[deviceObj.second->productId]->detachDevice(deviceObj.second->deviceHandle);
             }
 
             cleanupDevice(deviceObj.second);
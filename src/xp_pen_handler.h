@@ -23,10 +23,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <set>
 #include "vendor_handler.h"
+#include "device_database.h"
 
 class xp_pen_handler : public vendor_handler {
 public:
-    xp_pen_handler();
+    xp_pen_handler(const device_database& database);
 
     int getVendorId();
     std::vector<int> getProductIds();
@@ -41,6 +41,11 @@ void xp_pen_unified_device::registerProduct(int productId, const std::string& na
     productNameMap[productId] = name;
 }
 
+void xp_pen_unified_device::addProduct(int productId, const std::string& name) {
+    registerProduct(productId, name);
+    transfer_handler::addProduct(productId, name);
+}
+
 std::string xp_pen_unified_device::getProductName(int productId) {
     auto it = productNameMap.find(productId);
     if (it != productNameMap.end()) {
@@ -109,7 +114,7 @@ bool xp_pen_unified_device::attachDevice(libusb_device_handle *handle, int inter
     // and amounted to 0 if we're lucky and some random value otherwise
     int maxWidth = /*(buf[12] << 16)*/ + (buf[3] << 8) + buf[2];
     int maxHeight = (buf[5] << 8) + buf[4];
-    maxPressure = (buf[9] << 8) + buf[8];
+    setMaxPressure((buf[9] << 8) + buf[8]);
     int resolution = (buf[11] << 8) + buf[10];
 
     std::string deviceName = getProductName(productId);
@@ -149,118 +154,12 @@ bool xp_pen_unified_device::attachDevice(libusb_device_handle *handle, int inter
 
     memcpy(padArgs.productName, padName.c_str(), padName.length());
 
-    auto pen_fd = create_pen(penArgs);
-    auto pad_fd = create_pad(padArgs);
+    auto pen_fd = create_pen(handle, penArgs);
+    auto pad_fd = create_pad(handle, padArgs);
     if (pen_fd < 0 || pad_fd < 0)
         return false;
-    uinputPens[handle] = pen_fd;
-    uinputPads[handle] = pad_fd;
+    getDeviceContext(handle)->pen.fd = pen_fd;
+    getDeviceContext(handle)->pad.fd = pad_fd;
 
     return true;
 }
-
-void xp_pen_unified_device::handleDigitizerEvent(libusb_device_handle *handle, unsigned char *data, size_t dataLen) {
-    if (data[1] <= 0xc0) {
-        // Extract the X and Y position
-        int penX = (data[3] << 8) + data[2];
-        int penY = (data[5] << 8) + data[4];
-
-        if (dataLen == 12) {
-            // This is currently only used by the Artist 24 Pro tablet
-            penX += data[10] << 16;
-        }
-
-        // Check to see if the pen is touching
-        std::bitset<8> stylusTipAndButton(data[1]);
-        int pressure = (data[7] << 8) + data[6];
-        pressure += offsetPressure;
-
-        // std::cout << "Pressure is (" << pressure << ")" << std::endl;
-
-        const bool isInProximity = stylusTipAndButton.test(5) && !stylusTipAndButton.test(4);
-        const bool isEraserBit = stylusTipAndButton.test(3);
-
-        const bool hasEraserEnteredProximity = isInProximity && isEraserBit;
-        const bool hasPenEnteredProximity = isInProximity && !isEraserBit;
-        const bool hasPenExitedProximity = stylusTipAndButton.test(6) && !eraserInProximity;
-        const bool hasEraserExitedProximity = stylusTipAndButton.test(6);
-
-        // Handle pen coming into/out of proximity
-        if (hasEraserEnteredProximity) {
-            handleEraserEnteredProximity(handle);
-        } else if (hasPenEnteredProximity) {
-            handlePenEnteredProximity(handle);
-        } else if (hasPenExitedProximity) {
-            handlePenLeftProximity(handle);
-        } else if (hasEraserExitedProximity) {
-            handleEraserLeftProximity(handle);
-        }
-
-        // Handle actual stylus to digitizer contact
-        if (stylusTipAndButton.test(0) && stylusTipAndButton.test(5)) {
-            handlePenTouchingDigitizer(handle, applyPressureCurve(pressure));
-        } else {
-            handlePenTouchingDigitizer(handle, 0);
-        }
-
-        // Grab the tilt values
-        short tiltx = (char)data[8];
-        short tilty = (char)data[9];
-
-        // Check to see if the stylus buttons are being pressed
-        if (stylusTipAndButton.test(1)) {
-            handleStylusButtonsPressed(handle, BTN_STYLUS);
-        } else if (stylusTipAndButton.test(2)) {
-            handleStylusButtonsPressed(handle, BTN_STYLUS2);
-        } else if (stylusButtonPressed > 0) {
-            handleStylusButtonUnpressed(handle);
-        }
-
-        handleCoordsAndTilt(handle, penX, penY, tiltx, tilty);
-
-        uinput_send(uinputPens[handle], EV_SYN, SYN_REPORT, 1);
-    }
-}
-
-void xp_pen_unified_device::handleGenericFrameEvent(
-    libusb_device_handle* handle, 
-    unsigned char* data, 
-    size_t dataLen,
-    int buttonByteIndex,
-    int dialByteIndex
-) {
-    if (data[1] >= 0xf0) {
-        long button = data[buttonByteIndex];
-        // Get the position of the first set bit
-        long position = ffsl(button);
-
-        std::bitset<8> dialBits(data[dialByteIndex]);
-
-        // Take the dial
-        short dialValue = 0;
-        if (dialBits.test(0)) {
-            dialValue = 1;
-        } else if (dialBits.test(1)) {
-            dialValue = -1;
-        }
-
-        bool shouldSyn = true;
-        bool dialEvent = false;
-
-        if (dialValue != 0) {
-            handleDialEvent(handle, REL_WHEEL, dialValue);
-            shouldSyn = false;
-            dialEvent = true;
-        }
-
-        if (button != 0) {
-            handlePadButtonPressed(handle, position);
-        } else if (!dialEvent) {
-            handlePadButtonUnpressed(handle);
-        }
-
-        if (shouldSyn) {
-            uinput_send(uinputPads[handle], EV_SYN, SYN_REPORT, 1);
-        }
-    }
-}
@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "button_mapping_configuration.h"
 #include "device_specification.h"
 #include <map>
+#include <strings.h>
 
 class xp_pen_unified_device : public transfer_handler {
 public:
@@ -43,6 +44,8 @@ public:
     
     // Register a product ID and name
     void registerProduct(int productId, const std::string& name);
+
+    void addProduct(int productId, const std::string& name) override;
     
     // Apply a default configuration
     void applyDefaultConfig(bool withDial = false);
@@ -52,17 +55,36 @@ protected:
     virtual bool attachToInterfaceId(int interfaceId);
     virtual unsigned short getDescriptorLength();
     bool attachDevice(libusb_device_handle* handle, int interfaceId, int productId);
-    void handleDigitizerEvent(libusb_device_handle* handle, unsigned char* data, size_t dataLen);
     virtual std::string getInitKey() override;
-    
-    // Common implementation for handling frame events
-    void handleGenericFrameEvent(
-        libusb_device_handle* handle, 
-        unsigned char* data, 
-        size_t dataLen,
-        int buttonByteIndex = 2,
-        int dialByteIndex = 7
-    );
+
+    // Decoders specialised from a model's report layout. Models call decodeReport with their layout from
+    // handleTransferData and only need code of their own for report types the layout can't describe. Reports too
+    // short for the layout are dropped before any field is read
+    template <const report_layout& Layout>
+    bool decodeReport(device_context* context, unsigned char* data, size_t dataLen) {
+        constexpr size_t minReportLength = Layout.minReportLength();
+        if (dataLen < minReportLength) {
+            return false;
+        }
+
+        return decodeReport(Layout, context, data, dataLen);
+    }
+
+    template <const report_layout& Layout>
+    void decodeDigitizer(device_context* context, unsigned char* data, size_t dataLen) {
+        constexpr size_t minReportLength = Layout.minReportLength();
+        if (dataLen < minReportLength) {
+            return;
+        }
+
+        decodeDigitizer(Layout, context, data, dataLen);
+    }
+
+    // The same decoders for layouts that are only known at runtime, such as those from the device database. They
+    // are always inlined so the templates above fold their layout into constants
+    __attribute__((always_inline)) bool decodeReport(const report_layout& layout, device_context* context, unsigned char* data, size_t dataLen);
+    __attribute__((always_inline)) void decodeDigitizer(const report_layout& layout, device_context* context, unsigned char* data, size_t dataLen);
+    __attribute__((always_inline)) void decodeFrame(const report_layout& layout, device_context* context, unsigned char* data, size_t dataLen);
     
     // Initialize pad button aliases based on number of buttons
     void initializePadButtonAliases(int numButtons);
@@ -74,5 +96,122 @@ protected:
     device_specification deviceSpec;
 };
 
+inline bool xp_pen_unified_device::decodeReport(const report_layout& layout, device_context* context, unsigned char* data, size_t dataLen) {
+    if (data[0] != layout.reportId) {
+        return true;
+    }
+
+    decodeDigitizer(layout, context, data, dataLen);
+    if (layout.hasFrame()) {
+        decodeFrame(layout, context, data, dataLen);
+    }
+
+    return true;
+}
+
+inline void xp_pen_unified_device::decodeDigitizer(const report_layout& layout, device_context* context, unsigned char* data, size_t dataLen) {
+    const int status = layout.status.read(data);
+    if (status > layout.maxDigitizerStatus) {
+        return;
+    }
+
+    auto statusBit = [status](int bit) {
+        return ((status >> bit) & 1) != 0;
+    };
+
+    int penX = layout.x.read(data);
+    int penY = layout.y.read(data);
+    if (layout.xHigh.present() && dataLen == layout.xHighReportLength) {
+        penX += layout.xHigh.read(data) << 16;
+    }
+
+    int pressure = layout.pressure.read(data) + offsetPressure;
+
+    const bool isInProximity = statusBit(layout.inRangeBit) && !statusBit(layout.outOfRangeBit);
+    const bool isEraserBit = statusBit(layout.eraserBit);
+
+    // Handle pen coming into/out of proximity
+    if (isInProximity && isEraserBit) {
+        handleEraserEnteredProximity(context);
+    } else if (isInProximity) {
+        handlePenEnteredProximity(context);
+    } else if (statusBit(layout.leavingBit) && !context->eraserInProximity) {
+        handlePenLeftProximity(context);
+    } else if (statusBit(layout.leavingBit)) {
+        handleEraserLeftProximity(context);
+    }
+
+    // Handle actual stylus to digitizer contact
+    if (statusBit(layout.tipBit) && statusBit(layout.inRangeBit)) {
+        handlePenTouchingDigitizer(context, applyPressureCurve(pressure));
+    } else {
+        handlePenTouchingDigitizer(context, 0);
+    }
+
+    short tiltX = (int8_t)layout.tiltX.read(data);
+    short tiltY = (int8_t)layout.tiltY.read(data);
+
+    if (statusBit(layout.barrelBit)) {
+        handleStylusButtonsPressed(context, BTN_STYLUS);
+    } else if (statusBit(layout.secondBarrelBit)) {
+        handleStylusButtonsPressed(context, BTN_STYLUS2);
+    } else if (context->stylusButtonPressed > 0) {
+        handleStylusButtonUnpressed(context);
+    }
+
+    handleCoordsAndTilt(context, penX, penY, tiltX, tiltY);
+
+    uinput_send(context->pen, EV_SYN, SYN_REPORT, 1);
+}
+
+inline void xp_pen_unified_device::decodeFrame(const report_layout& layout, device_context* context, unsigned char* data, size_t dataLen) {
+    if (layout.status.read(data) < layout.minFrameStatus) {
+        return;
+    }
+
+    long button = layout.buttons.present() ? layout.buttons.read(data) : 0;
+    // The lowest set bit is the button number
+    long position = ffsl(button);
+
+    short wheelValue = 0;
+    short hWheelValue = 0;
+    if (layout.dial.present()) {
+        const int dialBits = layout.dial.read(data);
+        if (dialBits & layout.wheelUpMask) {
+            wheelValue = 1;
+        } else if (dialBits & layout.wheelDownMask) {
+            wheelValue = -1;
+        }
+
+        if (dialBits & layout.hWheelUpMask) {
+            hWheelValue = 1;
+        } else if (dialBits & layout.hWheelDownMask) {
+            hWheelValue = -1;
+        }
+    }
+
+    // Dial events send their own SYN_REPORT
+    bool dialEvent = false;
+    if (wheelValue != 0) {
+        handleDialEvent(context, REL_WHEEL, wheelValue);
+        dialEvent = true;
+    }
+
+    if (hWheelValue != 0) {
+        handleDialEvent(context, REL_HWHEEL, hWheelValue);
+        dialEvent = true;
+    }
+
+    if (button != 0) {
+        handlePadButtonPressed(context, position);
+    } else if (!dialEvent) {
+        handlePadButtonUnpressed(context);
+    }
+
+    if (!dialEvent) {
+        uinput_send(context->pad, EV_SYN, SYN_REPORT, 1);
+    }
+}
+
 
 #endif //USERSPACE_TABLET_DRIVER_DAEMON_XP_PEN_UNIFIED_DEVICE_H
@@ -0,0 +1,256 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <libusb-1.0/libusb.h>
+#include "vendor_handler.h"
+#include "transfer_ring.h"
+#include "artist_12_pro.h"
+#include "memory_sink.h"
+
+// Sends a long run of GUI messages to a device that is streaming reports at the same time and checks that memory
+// stays flat: once the first messages have warmed up the pools, handling another message must not leave anything
+// allocated behind, and the only libusb transfers alive between messages are the ones of the report ring.
+//
+// libusb is replaced by a queue of submitted transfers that the test completes itself, so no hardware is needed.
+
+static long liveAllocations = 0;
+
+// Kept out of line so the compiler never sees malloc or free paired with new or delete
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++liveAllocations;
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    if (pointer != nullptr) {
+        --liveAllocations;
+    }
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+    if (pointer != nullptr) {
+        --liveAllocations;
+    }
+    free(pointer);
+}
+
+static long liveTransfers = 0;
+static std::deque<libusb_transfer*> submittedTransfers;
+
+libusb_transfer* libusb_alloc_transfer(int isoPackets) {
+    ++liveTransfers;
+    return new libusb_transfer{};
+}
+
+void libusb_free_transfer(libusb_transfer* transfer) {
+    --liveTransfers;
+    delete transfer;
+}
+
+int libusb_submit_transfer(libusb_transfer* transfer) {
+    transfer->status = LIBUSB_TRANSFER_COMPLETED;
+    submittedTransfers.push_back(transfer);
+    return 0;
+}
+
+int libusb_cancel_transfer(libusb_transfer* transfer) {
+    transfer->status = LIBUSB_TRANSFER_CANCELLED;
+    return 0;
+}
+
+// Completes the submitted transfers that match, at most limit of them, as if the device had answered. Whatever
+// the callbacks submit again goes to the back of the queue just like on a real endpoint
+static int completeTransfers(const std::function<bool(libusb_transfer*)>& matches, int limit) {
+    std::deque<libusb_transfer*> transfers;
+    transfers.swap(submittedTransfers);
+
+    std::deque<libusb_transfer*> waiting;
+    int completed = 0;
+    for (auto transfer : transfers) {
+        if (completed == limit || !matches(transfer)) {
+            waiting.push_back(transfer);
+            continue;
+        }
+
+        if (transfer->status == LIBUSB_TRANSFER_COMPLETED && (transfer->endpoint & LIBUSB_ENDPOINT_IN)) {
+            // A pen hovering over the tablet
+            memset(transfer->buffer, 0, transfer->length);
+            transfer->buffer[0] = 0x02;
+            transfer->buffer[1] = 0xa0;
+            transfer->buffer[2] = completed & 0xff;
+        }
+        transfer->actual_length = transfer->length;
+
+        ++completed;
+        transfer->callback(transfer);
+    }
+
+    waiting.insert(waiting.end(), submittedTransfers.begin(), submittedTransfers.end());
+    submittedTransfers.swap(waiting);
+
+    return completed;
+}
+
+static const unsigned char reportEndpoint = 0x81;
+static const unsigned char unreadEndpoint = 0x82;
+
+static bool isEndpoint(libusb_transfer* transfer, unsigned char endpoint) {
+    return transfer->endpoint == endpoint;
+}
+
+class soak_handler : public vendor_handler {
+public:
+    std::string vendorName() override {
+        return "Soak test";
+    }
+
+    using vendor_handler::submitControlTransfer;
+    using vendor_handler::releaseTransfers;
+    using vendor_handler::transferRings;
+    using vendor_handler::controlTransfers;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+int main() {
+    const int warmupMessages = 1000;
+    const int soakMessages = 50000;
+    const int ringTransfers = 4;
+
+    memory_sink sink;
+    artist_12_pro tablet;
+    tablet.setInputSink(&sink);
+    tablet.setConfig(nlohmann::json({}));
+
+    auto handle = (libusb_device_handle*)(uintptr_t)1;
+    device_context* context = tablet.attachReplayDevice(handle, 8191);
+
+    unix_socket_message_queue queue;
+    soak_handler handler;
+    handler.setMessageQueue(&queue);
+
+    transfer_handler_pair dataPair{};
+    dataPair.transferHandler = &tablet;
+    dataPair.context = context;
+    dataPair.productId = 0x080a;
+    auto ring = new transfer_ring(dataPair, 0x28bd);
+    if (!ring->submit(handle, reportEndpoint, 16, ringTransfers)) {
+        std::cout << "Could not submit the report ring" << std::endl;
+        return 1;
+    }
+    handler.transferRings.push_back(ring);
+
+    std::vector<unix_socket_message*> messages;
+    std::vector<unix_socket_message*> responses;
+    unsigned long receivedResponses = 0;
+    long allocationsAfterWarmup = 0;
+
+    for (int i = 0; i < warmupMessages + soakMessages; ++i) {
+        // Every other request is answered on the endpoint the ring reads and the rest on one only the request reads
+        bool answeredOnRing = (i & 1) == 0;
+
+        auto message = queue.createMessage(4);
+        message->destination = message_destination::driver;
+        message->vendor = 0x28bd;
+        message->device = 0x080a;
+        message->interface = 2;
+        message->expectResponse = true;
+        message->responseLength = 16;
+        message->responseInterface = answeredOnRing ? (reportEndpoint & 0x0f) : (unreadEndpoint & 0x0f);
+        message->originatingSocket = 7;
+        message->requestId = i;
+        message->data[0] = 0x02;
+        message->data[1] = 0xb0;
+        message->data[2] = 0x04;
+        message->data[3] = i & 0xff;
+        queue.addMessage(message);
+
+        queue.getMessagesFor(message_destination::driver, 0x28bd, messages);
+        for (auto queued : messages) {
+            check(handler.submitControlTransfer(handle, queued), "message " + std::to_string(i) + " was submitted");
+            queue.releaseMessage(queued);
+        }
+
+        // The request goes out, the device keeps reporting, then the answer comes back
+        completeTransfers([](libusb_transfer* transfer) { return !(transfer->endpoint & LIBUSB_ENDPOINT_IN); }, -1);
+        completeTransfers([](libusb_transfer* transfer) { return isEndpoint(transfer, reportEndpoint); }, 1);
+        if (!answeredOnRing) {
+            completeTransfers([](libusb_transfer* transfer) { return isEndpoint(transfer, unreadEndpoint); }, -1);
+        }
+        completeTransfers([](libusb_transfer* transfer) { return isEndpoint(transfer, reportEndpoint); }, 2);
+
+        queue.getResponses(responses);
+        for (auto response : responses) {
+            ++receivedResponses;
+            queue.releaseMessage(response);
+        }
+
+        if (i == warmupMessages - 1) {
+            allocationsAfterWarmup = liveAllocations;
+        }
+
+        if (i >= warmupMessages && (i % 10000 == 0 || i == warmupMessages + soakMessages - 1)) {
+            // Taken before building the messages below, which allocate themselves
+            long allocations = liveAllocations;
+            std::string after = " after " + std::to_string(i + 1) + " messages";
+            check(allocations == allocationsAfterWarmup,
+                  "allocations stay at " + std::to_string(allocationsAfterWarmup) + after + " (" +
+                  std::to_string(allocations) + " live)");
+            check(liveTransfers == ringTransfers, "only the ring transfers are alive" + after);
+            check(handler.controlTransfers.empty(), "no request is left behind" + after);
+        }
+    }
+
+    check(receivedResponses == (unsigned long)(warmupMessages + soakMessages), "every message got its response");
+
+    // Unplugging hands every transfer back to libusb and the ring is freed once they have all come back
+    handler.releaseTransfers(handle);
+    completeTransfers([](libusb_transfer*) { return true; }, -1);
+    check(submittedTransfers.empty(), "nothing is submitted after the device is released");
+    check(handler.transferRings.empty(), "the ring is released with its device");
+
+    if (failures > 0) {
+        std::cout << failures << " soak checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Handled " << receivedResponses << " GUI messages with " << allocationsAfterWarmup
+              << " live allocations throughout" << std::endl;
+    return 0;
+}
@@ -0,0 +1,249 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "report_capture.h"
+#include "report_capture_reader.h"
+#include "xp_pen_handler.h"
+#include "memory_sink.h"
+
+// Two tablets of the same model share one transfer handler but each has its own device context and uinput devices.
+// Replaying their captures interleaved report by report has to give every tablet exactly the output it gives when it
+// is replayed on its own, so nothing one tablet does can leak into the state of the other.
+
+static const short xpPenVendorId = 0x28bd;
+static const short artist12ProId = 0x080a;
+static const int artist12ProMaxPressure = 8191;
+
+// Keeps what was written to each fd on top of what the memory sink records
+class recording_sink : public memory_sink {
+public:
+    bool writeEvents(int fd, const struct input_event* events, size_t count) override {
+        auto& written = eventsByFd[fd];
+        written.insert(written.end(), events, events + count);
+        return memory_sink::writeEvents(fd, events, count);
+    }
+
+    std::map<int, std::vector<struct input_event>> eventsByFd;
+};
+
+struct device_output {
+    std::vector<struct input_event> pen;
+    std::vector<struct input_event> pad;
+    std::vector<struct input_event> pointer;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static void penReport(std::vector<std::vector<unsigned char>>& reports, unsigned char status, int x, int y, int pressure) {
+    reports.push_back({0x02, status, (unsigned char)(x & 0xff), (unsigned char)(x >> 8), (unsigned char)(y & 0xff),
+                       (unsigned char)(y >> 8), (unsigned char)(pressure & 0xff), (unsigned char)(pressure >> 8), 0, 0});
+}
+
+static void padReport(std::vector<std::vector<unsigned char>>& reports, unsigned char buttons, unsigned char dial) {
+    reports.push_back({0x02, 0xf0, buttons, 0, 0, 0, 0, dial, 0, 0});
+}
+
+static bool writeCapture(const std::string& path, const std::vector<std::vector<unsigned char>>& reports) {
+    report_capture capture;
+    if (!capture.open(path)) {
+        return false;
+    }
+
+    uint64_t timestamp = 0;
+    for (auto& report : reports) {
+        capture.writeReport(xpPenVendorId, artist12ProId, 0x81, artist12ProMaxPressure, timestamp += 1000000,
+                            report.data(), report.size());
+    }
+
+    capture.close();
+    return true;
+}
+
+// Replays the captures into one handler, taking one record from each capture in turn
+static std::vector<device_output> replay(const std::vector<std::string>& capturePaths) {
+    recording_sink sink;
+    xp_pen_handler handler((device_database()));
+    handler.setInputSink(&sink);
+    handler.setConfig(nlohmann::json({}));
+
+    transfer_handler* productHandler = handler.getProductHandler(artist12ProId);
+    if (productHandler == nullptr) {
+        check(false, "the Artist 12 Pro has a handler");
+        return {};
+    }
+
+    std::vector<report_capture_reader> readers(capturePaths.size());
+    std::vector<device_context*> contexts(capturePaths.size(), nullptr);
+    std::vector<bool> finished(capturePaths.size(), false);
+    for (size_t i = 0; i < capturePaths.size(); ++i) {
+        finished[i] = !readers[i].open(capturePaths[i]);
+    }
+
+    size_t remaining = capturePaths.size();
+    while (remaining > 0) {
+        for (size_t i = 0; i < readers.size(); ++i) {
+            capture_record record;
+            if (finished[i]) {
+                continue;
+            }
+
+            if (!readers[i].next(record)) {
+                finished[i] = true;
+                --remaining;
+                continue;
+            }
+
+            if (record.type == capture_record_type::captureDevice) {
+                // Every capture is its own physical tablet even though they are the same model
+                auto handle = (libusb_device_handle*)(uintptr_t)(i + 1);
+                contexts[i] = productHandler->attachReplayDevice(handle, record.maxPressure);
+                productHandler->setOffsetPressure(record.productId);
+                continue;
+            }
+
+            if (contexts[i] != nullptr) {
+                productHandler->handleTransferData(contexts[i], record.data.data(), record.data.size(), record.productId);
+                productHandler->flushPendingEvents(contexts[i]);
+            }
+        }
+    }
+
+    std::vector<device_output> outputs(capturePaths.size());
+    for (size_t i = 0; i < contexts.size(); ++i) {
+        if (contexts[i] == nullptr) {
+            check(false, "capture " + std::to_string(i) + " attached a device");
+            continue;
+        }
+
+        outputs[i].pen = sink.eventsByFd[contexts[i]->pen.fd];
+        outputs[i].pad = sink.eventsByFd[contexts[i]->pad.fd];
+        outputs[i].pointer = sink.eventsByFd[contexts[i]->pointer.fd];
+    }
+
+    return outputs;
+}
+
+static bool sameEvents(const std::vector<struct input_event>& a, const std::vector<struct input_event>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].code != b[i].code || a[i].value != b[i].value) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool hasEvent(const std::vector<struct input_event>& events, uint16_t type, uint16_t code, int32_t value) {
+    for (auto& event : events) {
+        if (event.type == type && event.code == code && event.value == value) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void checkSameOutput(const device_output& alone, const device_output& interleaved, const std::string& name) {
+    check(sameEvents(alone.pen, interleaved.pen), name + ": pen events are the same as when replayed alone");
+    check(sameEvents(alone.pad, interleaved.pad), name + ": pad events are the same as when replayed alone");
+    check(sameEvents(alone.pointer, interleaved.pointer), name + ": pointer events are the same as when replayed alone");
+}
+
+int main() {
+    auto directory = std::filesystem::temp_directory_path();
+    std::string drawingPath = (directory / ("multi_device_test_drawing_" + std::to_string(getpid()) + ".cap")).string();
+    std::string padPath = (directory / ("multi_device_test_pad_" + std::to_string(getpid()) + ".cap")).string();
+
+    // The first tablet draws a stroke with the barrel button held part of the way
+    std::vector<std::vector<unsigned char>> drawing;
+    penReport(drawing, 0xa0, 1000, 1000, 0);
+    for (int i = 0; i < 40; ++i) {
+        unsigned char status = (i >= 15 && i < 25) ? 0xa3 : 0xa1;
+        penReport(drawing, status, 1000 + i * 37, 1000 + i * 11, 200 + i * 150);
+    }
+    penReport(drawing, 0xa0, 2480, 1440, 0);
+    penReport(drawing, 0xc0, 2480, 1440, 0);
+
+    // The second tablet hovers somewhere else, then presses pad buttons and turns the dial while the first draws
+    std::vector<std::vector<unsigned char>> pad;
+    for (int i = 0; i < 10; ++i) {
+        penReport(pad, 0xa0, 20000 - i * 50, 9000, 0);
+    }
+    penReport(pad, 0xc0, 19550, 9000, 0);
+    for (int i = 0; i < 8; ++i) {
+        padReport(pad, 1 << i, 0);
+        padReport(pad, 0, 0);
+    }
+    for (int i = 0; i < 6; ++i) {
+        padReport(pad, 0, (i & 1) ? 0x01 : 0x02);
+        padReport(pad, 0, 0);
+    }
+
+    if (!writeCapture(drawingPath, drawing) || !writeCapture(padPath, pad)) {
+        std::cout << "Could not write the captures to " << directory << std::endl;
+        return 1;
+    }
+
+    auto drawingAlone = replay({drawingPath});
+    auto padAlone = replay({padPath});
+    auto interleaved = replay({drawingPath, padPath});
+
+    std::remove(drawingPath.c_str());
+    std::remove(padPath.c_str());
+
+    if (drawingAlone.size() != 1 || padAlone.size() != 1 || interleaved.size() != 2) {
+        std::cout << "Replays did not produce a device per capture" << std::endl;
+        return 1;
+    }
+
+    // Make sure the captures exercise what they are meant to before comparing them
+    check(hasEvent(drawingAlone[0].pen, EV_KEY, BTN_TOUCH, 1), "the drawing capture touches the digitizer");
+    check(hasEvent(drawingAlone[0].pen, EV_KEY, BTN_STYLUS, 1), "the drawing capture presses the barrel button");
+    check(!hasEvent(padAlone[0].pen, EV_KEY, BTN_TOUCH, 1), "the pad capture never touches the digitizer");
+    check(!padAlone[0].pad.empty() || !padAlone[0].pointer.empty(), "the pad capture sends pad events");
+
+    checkSameOutput(drawingAlone[0], interleaved[0], "drawing tablet");
+    checkSameOutput(padAlone[0], interleaved[1], "pad tablet");
+
+    if (failures > 0) {
+        std::cout << failures << " multi device checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All multi device checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include "artist_12_pro.h"
+
+// Checks that the pressure lookup table built on config and attach gives the same value as evaluating the curve
+// directly, for every raw pressure a device can report.
+
+class pressure_test_device : public artist_12_pro {
+public:
+    using artist_12_pro::setMaxPressure;
+    using artist_12_pro::applyPressureCurve;
+    using artist_12_pro::evaluatePressureCurve;
+    using artist_12_pro::pressureTable;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static nlohmann::json curveConfig(const std::vector<std::pair<int, int>>& points) {
+    nlohmann::json config({});
+    for (auto& point : points) {
+        config["pressure_curve"].push_back({point.first, point.second});
+    }
+    return config;
+}
+
+static void checkTable(pressure_test_device& device, int maxPressure, const std::string& curveName) {
+    std::string name = curveName + " at max pressure " + std::to_string(maxPressure);
+
+    check(device.pressureTable.size() == (size_t)maxPressure + 1, name + ": table covers 0 to maxPressure");
+
+    int mismatches = 0;
+    for (int pressure = 0; pressure <= maxPressure; ++pressure) {
+        if (device.applyPressureCurve(pressure) != device.evaluatePressureCurve(pressure)) {
+            if (mismatches++ == 0) {
+                std::cout << "  pressure " << pressure << " looked up " << device.applyPressureCurve(pressure)
+                          << " but the curve gives " << device.evaluatePressureCurve(pressure) << std::endl;
+            }
+        }
+    }
+    check(mismatches == 0, name + ": every table entry matches the curve");
+
+    check(device.applyPressureCurve(0) == 0, name + ": no pressure stays at 0");
+
+    // Reports above the probed maximum fall off the end of the table and are evaluated directly
+    check(device.applyPressureCurve(maxPressure + 1) == device.evaluatePressureCurve(maxPressure + 1),
+          name + ": pressure past the maximum falls back to the curve");
+}
+
+int main() {
+    const std::vector<int> maxPressures = {1, 2, 255, 1023, 2047, 8191, 16383};
+
+    const std::vector<std::pair<std::string, std::vector<std::pair<int, int>>>> curves = {
+            {"linear", {}},
+            {"soft", {{0, 0}, {25, 60}, {100, 100}}},
+            {"firm", {{0, 0}, {60, 10}, {85, 40}, {100, 100}}},
+            {"capped", {{0, 0}, {50, 80}, {100, 80}}},
+    };
+
+    for (auto& curve : curves) {
+        pressure_test_device device;
+        device.setConfig(curveConfig(curve.second));
+
+        for (auto maxPressure : maxPressures) {
+            device.setMaxPressure(maxPressure);
+            checkTable(device, maxPressure, curve.first);
+        }
+    }
+
+    // The linear curve has to give the full range back, including the top value
+    pressure_test_device linear;
+    linear.setConfig(curveConfig({}));
+    for (auto maxPressure : maxPressures) {
+        linear.setMaxPressure(maxPressure);
+        check(linear.applyPressureCurve(maxPressure) == maxPressure,
+              "linear curve reaches " + std::to_string(maxPressure));
+    }
+
+    // A new curve arriving from the GUI after the device attached has to replace the table
+    pressure_test_device reconfigured;
+    reconfigured.setConfig(curveConfig({}));
+    reconfigured.setMaxPressure(8191);
+    reconfigured.setConfig(curveConfig({{0, 0}, {25, 60}, {100, 100}}));
+    checkTable(reconfigured, 8191, "reconfigured curve");
+
+    // Before the device has been probed there is no maximum to build a table for
+    pressure_test_device unprobed;
+    unprobed.setConfig(curveConfig({}));
+    unprobed.setMaxPressure(0);
+    check(unprobed.pressureTable.empty(), "no table without a max pressure");
+    check(unprobed.applyPressureCurve(0) == 0, "no pressure stays at 0 without a max pressure");
+
+    if (failures > 0) {
+        std::cout << failures << " pressure table checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All pressure table checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+userspace_tablet_driver_daemon
+Copyright (C) 2021 - Aren Villanueva <https://github.com/kurikaesu/>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "artist_24_pro.h"
+#include "memory_sink.h"
+#include "uinput_device_pool.h"
+
+// Two identical Artist 24 Pros unplugged and plugged back in the other order have to get back the pen and pad devices
+// they had before. They look the same in every argument their devices are created with, so only the port they are
+// plugged into tells them apart.
+
+// The fake libusb below hands out devices and handles that are just the port number, the bus is always 1
+static libusb_device_handle* handleOnPort(uint8_t port) {
+    return (libusb_device_handle*)(uintptr_t)port;
+}
+
+libusb_device* libusb_get_device(libusb_device_handle* handle) {
+    return (libusb_device*)handle;
+}
+
+uint8_t libusb_get_bus_number(libusb_device* device) {
+    return 1;
+}
+
+int libusb_get_port_numbers(libusb_device* device, uint8_t* ports, int length) {
+    if (length < 1) {
+        return LIBUSB_ERROR_OVERFLOW;
+    }
+
+    ports[0] = (uint8_t)(uintptr_t)device;
+    return 1;
+}
+
+// Exposes device creation so the test doesn't need a tablet to answer the attach handshake
+class pool_artist_24_pro : public artist_24_pro {
+public:
+    using artist_24_pro::create_pen;
+    using artist_24_pro::create_pad;
+};
+
+struct tablet_devices {
+    int pen;
+    int pad;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static uinput_pen_args penArgs() {
+    struct uinput_pen_args args {
+            .maxWidth = 95200,
+            .maxHeight = 53580,
+            .maxPressure = 8191,
+            .resolution = 200,
+            .maxTiltX = 60,
+            .maxTiltY = 60,
+            .vendorId = 0x28bd,
+            .productId = 0x092d,
+            .versionId = 1,
+    };
+    strcpy(args.productName, "XP-Pen Artist 24 Pro");
+
+    return args;
+}
+
+static uinput_pad_args padArgs() {
+    struct uinput_pad_args args {
+            .padButtonAliases = {BTN_0, BTN_1, BTN_2, BTN_3},
+            .hasWheel = true,
+            .hasHWheel = false,
+            .wheelMax = 1,
+            .hWheelMax = 1,
+            .vendorId = 0x28bd,
+            .productId = 0x092d,
+            .versionId = 1,
+    };
+    strcpy(args.productName, "XP-Pen Artist 24 Pro Pad");
+
+    return args;
+}
+
+static tablet_devices attach(pool_artist_24_pro& handler, libusb_device_handle* handle) {
+    device_context* context = handler.getDeviceContext(handle);
+    context->pen.fd = handler.create_pen(handle, penArgs());
+    context->pad.fd = handler.create_pad(handle, padArgs());
+
+    return {context->pen.fd, context->pad.fd};
+}
+
+int main() {
+    memory_sink sink;
+    uinput_device_pool pool(&sink);
+    pool.setGracePeriod(60);
+
+    pool_artist_24_pro handler;
+    handler.setInputSink(&sink);
+    handler.setDevicePool(&pool);
+
+    auto left = handleOnPort(1);
+    auto right = handleOnPort(2);
+
+    tablet_devices leftBefore = attach(handler, left);
+    tablet_devices rightBefore = attach(handler, right);
+    check(leftBefore.pen >= 0 && leftBefore.pad >= 0 && rightBefore.pen >= 0 && rightBefore.pad >= 0,
+          "both tablets got devices");
+    check(leftBefore.pen != rightBefore.pen && leftBefore.pad != rightBefore.pad, "the tablets got separate devices");
+
+    // Unplug both, then plug them back in the other order. A pool that only looked at the device arguments would
+    // hand the right tablet the devices the left one parked first
+    handler.detachDevice(left);
+    handler.detachDevice(right);
+
+    tablet_devices rightAfter = attach(handler, right);
+    tablet_devices leftAfter = attach(handler, left);
+    check(rightAfter.pen == rightBefore.pen, "the right tablet got its own pen back");
+    check(rightAfter.pad == rightBefore.pad, "the right tablet got its own pad back");
+    check(leftAfter.pen == leftBefore.pen, "the left tablet got its own pen back");
+    check(leftAfter.pad == leftBefore.pad, "the left tablet got its own pad back");
+
+    // A third identical tablet on a port nobody parked anything for gets new devices instead of waiting ones
+    handler.detachDevice(left);
+    auto third = handleOnPort(3);
+    tablet_devices thirdDevices = attach(handler, third);
+    check(thirdDevices.pen != leftBefore.pen && thirdDevices.pad != leftBefore.pad,
+          "a tablet on another port doesn't take parked devices");
+
+    tablet_devices leftAgain = attach(handler, left);
+    check(leftAgain.pen == leftBefore.pen && leftAgain.pad == leftBefore.pad,
+          "the left tablet still finds its devices after another tablet attached");
+
+    handler.detachDevice(left);
+    handler.detachDevice(right);
+    handler.detachDevice(third);
+
+    if (failures > 0) {
+        std::cout << failures << " device pool checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All device pool checks passed" << std::endl;
+    return 0;
+}